@@ -44,11 +44,14 @@ typedef double           f64;
 #define PAGE_TYPE        seL4_X86_4K
 #define PAGE_SIZE        4096
 
+#define PARSER_HEAP_PAGES 128        // memory for the calculator's parser, enough for 4096 variables
+
 // --------------------------------------------------------------------------------
 // writing characters in video memory
 // see https://wiki.osdev.org/Printing_To_Screen
 // see https://jbwyatt.com/253/emu/memory.html
 #define CHAROUT_PHYS     0x000b8000
+#define CHAROUT_PAGES    8           // whole 32 kB text window, used for hardware scrolling
 
 #define ATTR_BOLD        0b00011111
 #define ATTR_INV         0b01110000
@@ -59,6 +62,29 @@ typedef double           f64;
 #define SCREEN_SIZE      (SCREEN_ROW_SIZE * SCREEN_COL_SIZE)
 // --------------------------------------------------------------------------------
 
+// --------------------------------------------------------------------------------
+// crt controller, selects the shown part of the text window
+// see http://www.osdever.net/FreeVGA/vga/crtcreg.htm
+#define CRTC_ADDR_PORT   0x3d4       // register index
+#define CRTC_DATA_PORT   0x3d5       // register value
+#define CRTC_CURSOR_BEGIN 0x0a       // first scan line of the cursor, bit 5: hidden
+#define CRTC_CURSOR_END  0x0b        // last scan line of the cursor
+#define CRTC_START_HI    0x0c        // start address of the shown text, in characters
+#define CRTC_START_LO    0x0d
+#define CRTC_CURSOR_HI   0x0e        // cursor address, in characters
+#define CRTC_CURSOR_LO   0x0f
+// --------------------------------------------------------------------------------
+
+// --------------------------------------------------------------------------------
+// serial console on the first 16550 uart
+// see https://wiki.osdev.org/Serial_Ports
+#define SERIAL_PORT      0x3f8       // first of the uart's eight ports
+#define SERIAL_PIC       0           // on which PIC is the uart?
+#define SERIAL_IRQ       4           // on which IRQ pin of the PIC is the uart?
+#define SERIAL_INT       36          // cpu interrupt to map to
+#define SERIAL_TX_SIZE   16384       // buffered output, power of two
+// --------------------------------------------------------------------------------
+
 // --------------------------------------------------------------------------------
 // reading the keyboard
 // see https://wiki.osdev.org/%228042%22_PS/2_Controller
@@ -0,0 +1,534 @@
+/**
+ * memory allocators for the expression parser
+ *
+ * @author agent
+ * @date 16-oct-2026
+ * @license GPLv3, see 'LICENSE' file
+ *
+ * References:
+ *	- https://en.wikipedia.org/wiki/Region-based_memory_management
+ *	- https://en.wikipedia.org/wiki/Memory_pool
+ *	- "The Art of Computer Programming", vol. 1, ISBN: 978-0201896831 (1997), ch. 2.5, boundary tags
+ */
+
+#include <stdlib.h>
+
+#include "expr_alloc.h"
+
+
+#define ALIGN_UP(size) (((size) + ARENA_ALIGN-1) & ~(u64)(ARENA_ALIGN-1))
+
+
+// ----------------------------------------------------------------------------
+// allocator interface
+// ----------------------------------------------------------------------------
+
+static void* libc_alloc(void* user, u64 size)
+{
+	(void)user;
+	return malloc(size);
+}
+
+
+static void* libc_realloc(void* user, void* ptr, u64 size)
+{
+	(void)user;
+	return realloc(ptr, size);
+}
+
+
+static void libc_free(void* user, void* ptr)
+{
+	(void)user;
+	free(ptr);
+}
+
+
+const struct ExprAllocator libc_allocator =
+{
+	.alloc = &libc_alloc,
+	.realloc = &libc_realloc,
+	.free = &libc_free,
+	.user = 0,
+	.bulk_free = 0,
+};
+
+
+void* expr_alloc(const struct ExprAllocator* alloc, u64 size)
+{
+	return (*alloc->alloc)(alloc->user, size);
+}
+
+
+void* expr_calloc(const struct ExprAllocator* alloc, u64 num, u64 size)
+{
+	void *mem = expr_alloc(alloc, num*size);
+	if(mem)
+		my_memset((i8*)mem, 0, num*size);
+	return mem;
+}
+
+
+void* expr_realloc(const struct ExprAllocator* alloc, void* ptr, u64 size)
+{
+	return (*alloc->realloc)(alloc->user, ptr, size);
+}
+
+
+void expr_free(const struct ExprAllocator* alloc, void* ptr)
+{
+	if(ptr)
+		(*alloc->free)(alloc->user, ptr);
+}
+// ----------------------------------------------------------------------------
+
+
+
+// ----------------------------------------------------------------------------
+// arena
+// ----------------------------------------------------------------------------
+
+/**
+ * use the given memory as first chunk, or request chunks from the backing allocator
+ */
+void arena_init(struct Arena* arena, void* mem, u64 size, const struct ExprAllocator* backing)
+{
+	arena->first = arena->cur = 0;
+	arena->backing = backing;
+
+	if(!mem)
+		return;
+
+	u64 offs = ALIGN_UP((u64)mem) - (u64)mem;
+	if(size < offs + sizeof(struct ArenaChunk))
+		return;
+
+	struct ArenaChunk *chunk = (struct ArenaChunk*)((u8*)mem + offs);
+	chunk->next = 0;
+	chunk->size = (size - offs - sizeof(struct ArenaChunk)) & ~(u64)(ARENA_ALIGN-1);
+	chunk->used = 0;
+	chunk->owned = 0;
+
+	arena->first = arena->cur = chunk;
+}
+
+
+/**
+ * return all chunks to the backing allocator
+ */
+void arena_deinit(struct Arena* arena)
+{
+	struct ArenaChunk *chunk = arena->first;
+	while(chunk)
+	{
+		struct ArenaChunk *next = chunk->next;
+		if(chunk->owned)
+			expr_free(arena->backing, chunk);
+		chunk = next;
+	}
+
+	arena->first = arena->cur = 0;
+}
+
+
+/**
+ * release all allocations at once, the chunks are kept for reuse
+ */
+void arena_reset(struct Arena* arena)
+{
+	arena->cur = arena->first;
+	if(arena->cur)
+		arena->cur->used = 0;
+}
+
+
+void* arena_alloc(struct Arena* arena, u64 size)
+{
+	size = ALIGN_UP(size);
+
+	struct ArenaChunk *chunk = arena->cur;
+	while(chunk)
+	{
+		if(chunk->size - chunk->used >= size)
+		{
+			void *mem = (u8*)(chunk + 1) + chunk->used;
+			chunk->used += size;
+			arena->cur = chunk;
+			return mem;
+		}
+
+		// chunks after the current one are free since the last reset
+		if(!chunk->next)
+			break;
+		chunk = chunk->next;
+		chunk->used = 0;
+	}
+
+	if(!arena->backing)
+		return 0;
+
+	u64 chunk_size = my_max(ARENA_CHUNK_SIZE, size);
+	struct ArenaChunk *new_chunk = (struct ArenaChunk*)expr_alloc(arena->backing,
+		sizeof(struct ArenaChunk) + chunk_size);
+	if(!new_chunk)
+		return 0;
+
+	new_chunk->next = 0;
+	new_chunk->size = chunk_size;
+	new_chunk->used = size;
+	new_chunk->owned = 1;
+
+	if(chunk)
+		chunk->next = new_chunk;
+	else
+		arena->first = new_chunk;
+	arena->cur = new_chunk;
+
+	return new_chunk + 1;
+}
+
+
+static i8* arena_grow_str(void* arena, u64 size)
+{
+	return (i8*)arena_alloc((struct Arena*)arena, size);
+}
+
+
+/**
+ * let a string builder continue in the arena once its buffer is full
+ */
+void strbuf_use_arena(struct StrBuf* buf, struct Arena* arena)
+{
+	buf->grow = arena_grow_str;
+	buf->user = arena;
+}
+// ----------------------------------------------------------------------------
+
+
+
+// ----------------------------------------------------------------------------
+// pool
+// ----------------------------------------------------------------------------
+
+void pool_init(struct Pool* pool, struct Arena* arena, u64 obj_size)
+{
+	pool->arena = arena;
+	pool->obj_size = my_max(obj_size, sizeof(void*));
+	pool->free_list = 0;
+}
+
+
+/**
+ * forget the free objects, used together with resetting the arena
+ */
+void pool_reset(struct Pool* pool)
+{
+	pool->free_list = 0;
+}
+
+
+void* pool_alloc(struct Pool* pool)
+{
+	void *obj = pool->free_list;
+	if(obj)
+	{
+		pool->free_list = *(void**)obj;
+		return obj;
+	}
+
+	return arena_alloc(pool->arena, pool->obj_size);
+}
+
+
+void pool_free(struct Pool* pool, void* obj)
+{
+	*(void**)obj = pool->free_list;
+	pool->free_list = obj;
+}
+// ----------------------------------------------------------------------------
+
+
+
+// ----------------------------------------------------------------------------
+// heap
+// blocks are carved from regions and know the sizes of their neighbours, so a
+// freed block is merged with its free neighbours and a block can grow in place;
+// the free blocks are kept in a list per power-of-two size class
+// ----------------------------------------------------------------------------
+
+#define HEAP_FREE 1ul       // flag in HeapBlock::size, the sizes are multiples of ARENA_ALIGN
+
+
+/**
+ * each block starts with a header holding its size and its predecessor's,
+ * each region ends with a header of size 0
+ */
+struct HeapBlock
+{
+	u64 size;               // size including the header, HEAP_FREE: the block is free
+	u64 prev_size;          // size of the preceding block, 0: first block of its region
+};
+
+
+/**
+ * free blocks keep their list links after the header
+ */
+struct HeapFree
+{
+	struct HeapBlock hdr;
+	struct HeapFree *next, *prev;
+};
+
+
+#define HEAP_MIN_BLOCK ALIGN_UP(sizeof(struct HeapFree))
+
+
+static inline u64 heap_block_size(const struct HeapBlock* block)
+{
+	return block->size & ~HEAP_FREE;
+}
+
+
+static inline struct HeapBlock* next_block(struct HeapBlock* block)
+{
+	return (struct HeapBlock*)((u8*)block + heap_block_size(block));
+}
+
+
+/**
+ * class c holds the free blocks of sizes [HEAP_MIN_BLOCK << c, HEAP_MIN_BLOCK << (c+1)[
+ */
+static int heap_class(u64 size)
+{
+	int size_class = 0;
+	while(size_class < HEAP_CLASSES-1 && (HEAP_MIN_BLOCK << (size_class+1)) <= size)
+		++size_class;
+	return size_class;
+}
+
+
+static void link_free(struct Heap* heap, struct HeapBlock* block)
+{
+	struct HeapFree *free_block = (struct HeapFree*)block;
+	struct HeapFree **list = heap->free_lists + heap_class(heap_block_size(block));
+
+	free_block->prev = 0;
+	free_block->next = *list;
+	if(*list)
+		(*list)->prev = free_block;
+	*list = free_block;
+}
+
+
+static void unlink_free(struct Heap* heap, struct HeapBlock* block)
+{
+	struct HeapFree *free_block = (struct HeapFree*)block;
+
+	if(free_block->prev)
+		free_block->prev->next = free_block->next;
+	else
+		heap->free_lists[heap_class(heap_block_size(block))] = free_block->next;
+	if(free_block->next)
+		free_block->next->prev = free_block->prev;
+}
+
+
+/**
+ * set the block's size and free flag, updating its successor
+ */
+static void set_block(struct HeapBlock* block, u64 size, u64 free_flag)
+{
+	block->size = size | free_flag;
+	next_block(block)->prev_size = size;
+}
+
+
+/**
+ * give the end of an allocated block back to the free lists if it is large enough
+ */
+static void split_block(struct Heap* heap, struct HeapBlock* block, u64 size)
+{
+	u64 rest = heap_block_size(block) - size;
+	if(rest < HEAP_MIN_BLOCK)
+		return;
+
+	set_block(block, size, 0);
+	struct HeapBlock *rest_block = next_block(block);
+	set_block(rest_block, rest, HEAP_FREE);
+	link_free(heap, rest_block);
+}
+
+
+/**
+ * turn memory from the arena into one free block
+ */
+static int add_region(struct Heap* heap, u64 size)
+{
+	size &= ~(u64)(ARENA_ALIGN-1);
+	if(size < HEAP_MIN_BLOCK + sizeof(struct HeapBlock))
+		return 0;
+
+	struct HeapBlock *block = (struct HeapBlock*)arena_alloc(&heap->arena, size);
+	if(!block)
+		return 0;
+
+	u64 block_size = size - sizeof(struct HeapBlock);
+	block->prev_size = 0;
+	block->size = block_size | HEAP_FREE;
+
+	struct HeapBlock *end = next_block(block);
+	end->size = 0;
+	end->prev_size = block_size;
+
+	link_free(heap, block);
+	return 1;
+}
+
+
+static struct HeapBlock* find_free(struct Heap* heap, u64 size)
+{
+	int size_class = heap_class(size);
+
+	// the smallest class may hold blocks which are too small
+	for(struct HeapFree *block = heap->free_lists[size_class]; block; block = block->next)
+	{
+		if(heap_block_size(&block->hdr) >= size)
+			return &block->hdr;
+	}
+
+	for(++size_class; size_class<HEAP_CLASSES; ++size_class)
+	{
+		if(heap->free_lists[size_class])
+			return &heap->free_lists[size_class]->hdr;
+	}
+
+	return 0;
+}
+
+
+static u64 heap_needed(u64 size)
+{
+	return my_max(ALIGN_UP(size + sizeof(struct HeapBlock)), HEAP_MIN_BLOCK);
+}
+
+
+static void* heap_alloc(void* user, u64 size)
+{
+	struct Heap *heap = (struct Heap*)user;
+	u64 needed = heap_needed(size);
+
+	struct HeapBlock *block = find_free(heap, needed);
+	if(!block)
+	{
+		if(!add_region(heap, my_max(ARENA_CHUNK_SIZE, needed + sizeof(struct HeapBlock))))
+			return 0;
+		block = find_free(heap, needed);
+	}
+
+	unlink_free(heap, block);
+	block->size &= ~HEAP_FREE;
+	split_block(heap, block, needed);
+
+	return block + 1;
+}
+
+
+static void heap_free(void* user, void* ptr)
+{
+	struct Heap *heap = (struct Heap*)user;
+	struct HeapBlock *block = (struct HeapBlock*)ptr - 1;
+	u64 size = heap_block_size(block);
+
+	struct HeapBlock *next = next_block(block);
+	if(next->size & HEAP_FREE)
+	{
+		unlink_free(heap, next);
+		size += heap_block_size(next);
+	}
+
+	if(block->prev_size)
+	{
+		struct HeapBlock *prev = (struct HeapBlock*)((u8*)block - block->prev_size);
+		if(prev->size & HEAP_FREE)
+		{
+			unlink_free(heap, prev);
+			size += heap_block_size(prev);
+			block = prev;
+		}
+	}
+
+	set_block(block, size, HEAP_FREE);
+	link_free(heap, block);
+}
+
+
+static void* heap_realloc(void* user, void* ptr, u64 size)
+{
+	if(!ptr)
+		return heap_alloc(user, size);
+
+	struct Heap *heap = (struct Heap*)user;
+	struct HeapBlock *block = (struct HeapBlock*)ptr - 1;
+	u64 needed = heap_needed(size);
+	u64 old_size = heap_block_size(block);
+	if(needed <= old_size)
+		return ptr;
+
+	// grow into the following free block
+	struct HeapBlock *next = next_block(block);
+	if((next->size & HEAP_FREE) && old_size + heap_block_size(next) >= needed)
+	{
+		unlink_free(heap, next);
+		set_block(block, old_size + heap_block_size(next), 0);
+		split_block(heap, block, needed);
+		return ptr;
+	}
+
+	void *new_ptr = heap_alloc(user, size);
+	if(!new_ptr)
+		return 0;
+
+	my_memcpy((i8*)new_ptr, (i8*)ptr, old_size - sizeof(struct HeapBlock));
+	heap_free(user, ptr);
+	return new_ptr;
+}
+
+
+/**
+ * use the given memory as one region, or request regions from the backing allocator
+ */
+void heap_init(struct Heap* heap, void* mem, u64 size, const struct ExprAllocator* backing)
+{
+	arena_init(&heap->arena, mem, size, backing);
+
+	for(int i=0; i<HEAP_CLASSES; ++i)
+		heap->free_lists[i] = 0;
+
+	if(heap->arena.first)
+		add_region(heap, heap->arena.first->size);
+}
+
+
+void heap_deinit(struct Heap* heap)
+{
+	arena_deinit(&heap->arena);
+
+	for(int i=0; i<HEAP_CLASSES; ++i)
+		heap->free_lists[i] = 0;
+}
+
+
+struct ExprAllocator heap_allocator(struct Heap* heap)
+{
+	struct ExprAllocator alloc =
+	{
+		.alloc = &heap_alloc,
+		.realloc = &heap_realloc,
+		.free = &heap_free,
+		.user = heap,
+		.bulk_free = 1,
+	};
+
+	return alloc;
+}
+// ----------------------------------------------------------------------------
@@ -0,0 +1,100 @@
+/**
+ * memory allocators for the expression parser
+ *
+ * @author agent
+ * @date 16-oct-2026
+ * @license GPLv3, see 'LICENSE' file
+ */
+
+#ifndef __EXPR_ALLOC_H__
+#define __EXPR_ALLOC_H__
+
+#include "string.h"
+
+
+#define ARENA_ALIGN      16             // alignment of all allocations
+#define ARENA_CHUNK_SIZE (16*1024)      // default size of chunks requested from the backing allocator
+#define HEAP_CLASSES     24             // free lists for block sizes from 32 B, doubling
+
+
+/**
+ * allocator interface, all memory of the parser is requested through it
+ */
+struct ExprAllocator
+{
+	void* (*alloc)(void* user, u64 size);
+	void* (*realloc)(void* user, void* ptr, u64 size);
+	void (*free)(void* user, void* ptr);
+	void *user;
+
+	int bulk_free;      // everything is released at once, so single objects need not be freed
+};
+
+
+struct ArenaChunk
+{
+	struct ArenaChunk *next;
+	u64 size;           // usable size following the header
+	u64 used;
+	u64 owned;          // chunk was requested from the backing allocator
+};
+
+
+/**
+ * bump allocator with constant-time reset
+ */
+struct Arena
+{
+	struct ArenaChunk *first, *cur;
+	const struct ExprAllocator *backing;    // provides further chunks, 0: fixed size
+};
+
+
+/**
+ * fixed-size objects with a free list, taken from an arena
+ */
+struct Pool
+{
+	struct Arena *arena;
+	u64 obj_size;
+	void *free_list;
+};
+
+
+struct HeapFree;
+
+
+/**
+ * general allocator merging freed blocks with their free neighbours
+ */
+struct Heap
+{
+	struct Arena arena;                         // provides the regions the blocks are taken from
+	struct HeapFree *free_lists[HEAP_CLASSES];  // free blocks per power-of-two size class
+};
+
+
+extern const struct ExprAllocator libc_allocator;
+
+extern void* expr_alloc(const struct ExprAllocator* alloc, u64 size);
+extern void* expr_calloc(const struct ExprAllocator* alloc, u64 num, u64 size);
+extern void* expr_realloc(const struct ExprAllocator* alloc, void* ptr, u64 size);
+extern void expr_free(const struct ExprAllocator* alloc, void* ptr);
+
+extern void arena_init(struct Arena* arena, void* mem, u64 size, const struct ExprAllocator* backing);
+extern void arena_deinit(struct Arena* arena);
+extern void arena_reset(struct Arena* arena);
+extern void* arena_alloc(struct Arena* arena, u64 size);
+extern void strbuf_use_arena(struct StrBuf* buf, struct Arena* arena);
+
+extern void pool_init(struct Pool* pool, struct Arena* arena, u64 obj_size);
+extern void pool_reset(struct Pool* pool);
+extern void* pool_alloc(struct Pool* pool);
+extern void pool_free(struct Pool* pool, void* obj);
+
+extern void heap_init(struct Heap* heap, void* mem, u64 size, const struct ExprAllocator* backing);
+extern void heap_deinit(struct Heap* heap);
+extern struct ExprAllocator heap_allocator(struct Heap* heap);
+
+
+#endif
@@ -0,0 +1,693 @@
+/**
+ * syntax tree of parsed expressions and its optimisation
+ *
+ * @author agent
+ * @date 16-oct-2026
+ * @license GPLv3, see 'LICENSE' file
+ *
+ * References:
+ *	- https://en.wikipedia.org/wiki/Hash_consing
+ *	- https://en.wikipedia.org/wiki/Common_subexpression_elimination
+ */
+
+#include <math.h>
+
+#include "expr_ast.h"
+
+
+// ----------------------------------------------------------------------------
+// helpers
+// ----------------------------------------------------------------------------
+
+static u64 hash_combine(u64 hash, u64 val)
+{
+	return (hash ^ val) * 0x100000001b3;
+}
+
+
+static u64 hash_bytes(u64 hash, const void* mem, u64 len)
+{
+	for(u64 i=0; i<len; ++i)
+		hash = hash_combine(hash, ((const u8*)mem)[i]);
+	return hash;
+}
+
+
+static int bytes_equal(const void* mem1, const void* mem2, u64 len)
+{
+	for(u64 i=0; i<len; ++i)
+	{
+		if(((const u8*)mem1)[i] != ((const u8*)mem2)[i])
+			return 0;
+	}
+	return 1;
+}
+
+
+/**
+ * is the node the given constant, also comparing the sign of zeros?
+ */
+static int is_value(const struct AstNode* node, t_value val)
+{
+	return node->type == AST_VALUE && bytes_equal(&node->val, &val, sizeof(val));
+}
+
+
+static t_value eval_binary(int op, t_value lhs, t_value rhs)
+{
+	switch(op)
+	{
+		case OP_ADD: return lhs + rhs;
+		case OP_SUB: return lhs - rhs;
+		case OP_MUL: return lhs * rhs;
+		case OP_DIV: return lhs / rhs;
+		case OP_MOD: return fmod(lhs, rhs);
+		case OP_POW: return pow(lhs, rhs);
+	}
+
+	return 0;
+}
+
+
+static t_value eval_call(int arity, union Func func, const t_value* args, int num_args)
+{
+	switch(arity)
+	{
+		case 0: return (*func.f0)();
+		case 1: return (*func.f1)(args[0]);
+		case 2: return (*func.f2)(args[0], args[1]);
+	}
+
+	return (*func.fn)(args, num_args);
+}
+// ----------------------------------------------------------------------------
+
+
+
+// ----------------------------------------------------------------------------
+// node construction
+// ----------------------------------------------------------------------------
+
+void init_ast_builder(struct AstBuilder* builder, struct Arena* arena)
+{
+	builder->arena = arena;
+	pool_init(&builder->node_pool, arena, sizeof(struct AstNode));
+	builder->num_nodes = 0;
+
+	builder->table = 0;
+	builder->table_cap = builder->table_len = 0;
+	builder->epoch = 0;
+}
+
+
+/**
+ * release all nodes at once
+ */
+void deinit_ast_builder(struct AstBuilder* builder)
+{
+	pool_reset(&builder->node_pool);
+	arena_reset(builder->arena);
+	builder->num_nodes = 0;
+
+	builder->table = 0;
+	builder->table_cap = builder->table_len = 0;
+	builder->epoch = 0;
+}
+
+
+static struct AstNode* new_node(struct AstBuilder* builder, int type, int num_args)
+{
+	struct AstNode *node = (struct AstNode*)pool_alloc(&builder->node_pool);
+	if(!node)
+		return 0;
+
+	node->type = type;
+	node->op = 0;
+	node->val = 0;
+	node->name = 0;
+	node->name_len = 0;
+	node->epoch = 0;
+	node->func.f0 = 0;
+	node->ufunc = 0;
+	node->pure = 1;
+	node->reads_vars = 0;
+	node->num_args = num_args;
+	node->hash = 0;
+	node->refs = 0;
+	node->temp = -1;
+	node->visited = 0;
+
+	if(num_args <= 2)
+	{
+		node->args = node->inline_args;
+	}
+	else
+	{
+		node->args = (struct AstNode**)arena_alloc(builder->arena,
+			num_args * sizeof(struct AstNode*));
+		if(!node->args)
+		{
+			pool_free(&builder->node_pool, node);
+			return 0;
+		}
+	}
+
+	++builder->num_nodes;
+	return node;
+}
+
+
+static u64 node_hash(const struct AstNode* node)
+{
+	u64 hash = 0xcbf29ce484222325;
+	hash = hash_combine(hash, node->type);
+	hash = hash_combine(hash, node->op);
+	hash = hash_combine(hash, node->epoch);
+	hash = hash_bytes(hash, &node->val, sizeof(node->val));
+	hash = hash_bytes(hash, node->name, node->name_len);
+	hash = hash_bytes(hash, &node->func, sizeof(node->func));
+	hash = hash_combine(hash, (u64)node->ufunc);
+	for(int i=0; i<node->num_args; ++i)
+		hash = hash_combine(hash, (u64)node->args[i]);
+
+	return hash;
+}
+
+
+static int nodes_equal(const struct AstNode* node1, const struct AstNode* node2)
+{
+	if(node1->hash != node2->hash || node1->type != node2->type || node1->op != node2->op)
+		return 0;
+	if(node1->epoch != node2->epoch || node1->num_args != node2->num_args)
+		return 0;
+	if(!bytes_equal(&node1->val, &node2->val, sizeof(node1->val)))
+		return 0;
+	if(!bytes_equal(&node1->func, &node2->func, sizeof(node1->func)) || node1->ufunc != node2->ufunc)
+		return 0;
+	if(node1->name_len != node2->name_len || !bytes_equal(node1->name, node2->name, node1->name_len))
+		return 0;
+
+	// the children are already unique
+	for(int i=0; i<node1->num_args; ++i)
+	{
+		if(node1->args[i] != node2->args[i])
+			return 0;
+	}
+
+	return 1;
+}
+
+
+/**
+ * return an identical, already existing node if there is one
+ * and free the new node in that case, otherwise register the new node
+ */
+static struct AstNode* unique_node(struct AstBuilder* builder, struct AstNode* node)
+{
+	node->hash = node_hash(node);
+
+	// keep the load factor below 1/2
+	if((builder->table_len+1)*2 > builder->table_cap)
+	{
+		u32 new_cap = builder->table_cap ? builder->table_cap*2 : 64;
+		struct AstNode **new_table = (struct AstNode**)arena_alloc(builder->arena,
+			new_cap * sizeof(struct AstNode*));
+		if(!new_table)
+			return node;
+		my_memset((i8*)new_table, 0, new_cap * sizeof(struct AstNode*));
+
+		for(u32 i=0; i<builder->table_cap; ++i)
+		{
+			struct AstNode *entry = builder->table[i];
+			if(!entry)
+				continue;
+
+			u32 pos = entry->hash & (new_cap-1);
+			while(new_table[pos])
+				pos = (pos+1) & (new_cap-1);
+			new_table[pos] = entry;
+		}
+
+		builder->table = new_table;
+		builder->table_cap = new_cap;
+	}
+
+	u32 mask = builder->table_cap - 1;
+	for(u32 pos = node->hash & mask; ; pos = (pos+1) & mask)
+	{
+		struct AstNode *entry = builder->table[pos];
+		if(!entry)
+		{
+			builder->table[pos] = node;
+			++builder->table_len;
+			return node;
+		}
+
+		if(nodes_equal(entry, node))
+		{
+			pool_free(&builder->node_pool, node);
+			--builder->num_nodes;
+			return entry;
+		}
+	}
+}
+
+
+struct AstNode* ast_value(struct AstBuilder* builder, t_value val)
+{
+	struct AstNode *node = new_node(builder, AST_VALUE, 0);
+	if(!node)
+		return 0;
+
+	node->val = val;
+	return unique_node(builder, node);
+}
+
+
+struct AstNode* ast_var(struct AstBuilder* builder, const char* name, int len)
+{
+	struct AstNode *node = new_node(builder, AST_VAR, 0);
+	if(!node)
+		return 0;
+
+	node->name = name;
+	node->name_len = len;
+	node->epoch = builder->epoch;
+	node->reads_vars = 1;
+	return unique_node(builder, node);
+}
+
+
+struct AstNode* ast_assign(struct AstBuilder* builder, const char* name, int len,
+	struct AstNode* val)
+{
+	if(!val)
+		return 0;
+
+	struct AstNode *node = new_node(builder, AST_ASSIGN, 1);
+	if(!node)
+		return 0;
+
+	node->name = name;
+	node->name_len = len;
+	node->args[0] = val;
+	node->pure = 0;
+	node->reads_vars = val->reads_vars;
+
+	// variables read after this point may have a different value
+	++builder->epoch;
+	return node;
+}
+
+
+struct AstNode* ast_unary(struct AstBuilder* builder, int op, struct AstNode* arg)
+{
+	if(!arg)
+		return 0;
+
+	if(op == OP_NEG)
+	{
+		// fold constant
+		if(arg->type == AST_VALUE)
+			return ast_value(builder, -arg->val);
+
+		// --x -> x
+		if(arg->type == AST_UNARY && arg->op == OP_NEG)
+			return arg->args[0];
+	}
+
+	struct AstNode *node = new_node(builder, AST_UNARY, 1);
+	if(!node)
+		return 0;
+
+	node->op = op;
+	node->args[0] = arg;
+	node->pure = arg->pure;
+	node->reads_vars = arg->reads_vars;
+	return node->pure ? unique_node(builder, node) : node;
+}
+
+
+struct AstNode* ast_binary(struct AstBuilder* builder, int op,
+	struct AstNode* lhs, struct AstNode* rhs)
+{
+	if(!lhs || !rhs)
+		return 0;
+
+	// fold constants
+	if(lhs->type == AST_VALUE && rhs->type == AST_VALUE)
+		return ast_value(builder, eval_binary(op, lhs->val, rhs->val));
+
+	// identities which hold for all values, the ones dropping an operand
+	// only apply if evaluating that operand can neither change nor fail anything
+	int lhs_droppable = lhs->pure && !lhs->reads_vars;
+
+	switch(op)
+	{
+		case OP_SUB:
+			if(is_value(rhs, 0))        // x-0 -> x
+				return lhs;
+			break;
+
+		case OP_MUL:
+			if(is_value(rhs, 1))        // x*1 -> x
+				return lhs;
+			if(is_value(lhs, 1))        // 1*x -> x
+				return rhs;
+			break;
+
+		case OP_DIV:
+			if(is_value(rhs, 1))        // x/1 -> x
+				return lhs;
+			break;
+
+		case OP_POW:
+			if(is_value(rhs, 1))        // x^1 -> x
+				return lhs;
+			if(is_value(rhs, 0) && lhs_droppable)   // x^0 -> 1
+				return ast_value(builder, 1);
+			if(is_value(rhs, 2))        // x^2 -> x*x
+				return ast_binary(builder, OP_MUL, lhs, lhs);
+			break;
+	}
+
+	struct AstNode *node = new_node(builder, AST_BINARY, 2);
+	if(!node)
+		return 0;
+
+	node->op = op;
+	node->args[0] = lhs;
+	node->args[1] = rhs;
+	node->pure = lhs->pure && rhs->pure;
+	node->reads_vars = lhs->reads_vars || rhs->reads_vars;
+	return node->pure ? unique_node(builder, node) : node;
+}
+
+
+struct AstNode* ast_call(struct AstBuilder* builder, int arity, union Func func,
+	int pure, struct AstNode** args, int num_args)
+{
+	int all_values = 1;
+	for(int i=0; i<num_args; ++i)
+	{
+		if(!args[i])
+			return 0;
+
+		if(args[i]->type != AST_VALUE)
+			all_values = 0;
+		if(!args[i]->pure)
+			pure = 0;
+	}
+
+	// fold calls to pure functions with constant arguments
+	if(pure && all_values && num_args <= EXPR_MAX_STACK)
+	{
+		t_value vals[EXPR_MAX_STACK];
+		for(int i=0; i<num_args; ++i)
+			vals[i] = args[i]->val;
+
+		return ast_value(builder, eval_call(arity, func, vals, num_args));
+	}
+
+	struct AstNode *node = new_node(builder, AST_CALL, num_args);
+	if(!node)
+		return 0;
+
+	node->op = arity;
+	node->func = func;
+	node->pure = pure;
+	for(int i=0; i<num_args; ++i)
+	{
+		node->args[i] = args[i];
+		node->reads_vars |= args[i]->reads_vars;
+	}
+
+	return pure ? unique_node(builder, node) : node;
+}
+
+
+/**
+ * argument of the function whose body is being built
+ */
+struct AstNode* ast_param(struct AstBuilder* builder, int param)
+{
+	struct AstNode *node = new_node(builder, AST_PARAM, 0);
+	if(!node)
+		return 0;
+
+	node->op = param;
+	return unique_node(builder, node);
+}
+
+
+/**
+ * call a user-defined function, these calls are not folded
+ * @param pure the function's result only depends on its arguments
+ */
+struct AstNode* ast_user_call(struct AstBuilder* builder, struct UserFunc* func,
+	int pure, struct AstNode** args, int num_args)
+{
+	for(int i=0; i<num_args; ++i)
+	{
+		if(!args[i])
+			return 0;
+	}
+
+	struct AstNode *node = new_node(builder, AST_USER_CALL, num_args);
+	if(!node)
+		return 0;
+
+	node->ufunc = func;
+	for(int i=0; i<num_args; ++i)
+	{
+		node->args[i] = args[i];
+		pure = pure && args[i]->pure;
+		node->reads_vars |= args[i]->reads_vars;
+	}
+	node->pure = pure;
+
+	return pure ? unique_node(builder, node) : node;
+}
+
+
+/**
+ * conditional, only the selected value is evaluated
+ */
+struct AstNode* ast_if(struct AstBuilder* builder, struct AstNode* cond,
+	struct AstNode* val_true, struct AstNode* val_false)
+{
+	if(!cond || !val_true || !val_false)
+		return 0;
+
+	// fold constant condition
+	if(cond->type == AST_VALUE)
+		return cond->val != 0 ? val_true : val_false;
+
+	struct AstNode *node = new_node(builder, AST_IF, 3);
+	if(!node)
+		return 0;
+
+	node->args[0] = cond;
+	node->args[1] = val_true;
+	node->args[2] = val_false;
+	node->pure = cond->pure && val_true->pure && val_false->pure;
+	node->reads_vars = cond->reads_vars || val_true->reads_vars || val_false->reads_vars;
+
+	return node->pure ? unique_node(builder, node) : node;
+}
+// ----------------------------------------------------------------------------
+
+
+
+// ----------------------------------------------------------------------------
+// code generation
+// ----------------------------------------------------------------------------
+
+/**
+ * count the references to each node reachable from the root,
+ * each node is put on the stack at most once
+ */
+static void count_refs(struct AstNode* root, struct AstNode** stack)
+{
+	u32 sp = 0;
+	stack[sp++] = root;
+
+	while(sp)
+	{
+		struct AstNode *node = stack[--sp];
+
+		for(int i=0; i<node->num_args; ++i)
+		{
+			struct AstNode *arg = node->args[i];
+			++arg->refs;
+
+			if(!arg->visited)
+			{
+				arg->visited = 1;
+				stack[sp++] = arg;
+			}
+		}
+	}
+}
+
+
+struct GenFrame
+{
+	struct AstNode *node;
+	int next_arg;       // next child to generate
+
+	int jump;           // AST_IF: jump to be patched after the current branch
+	int first_temp;     // AST_IF: first temporary assigned in the current branch
+};
+
+
+/**
+ * temporaries which are assigned in a branch are not valid after it
+ */
+static void end_branch(struct ExprProgram* prog, struct AstNode** temp_nodes, int first_temp)
+{
+	for(int temp=first_temp; temp<prog->num_temps; ++temp)
+		temp_nodes[temp]->temp = -1;
+}
+
+
+/**
+ * emit the jumps of a conditional after the given child has been generated:
+ * cond, OP_JZ, true value, OP_JMP, false value
+ */
+static void gen_branch(struct GenFrame* frame, struct ExprProgram* prog,
+	struct AstNode** temp_nodes)
+{
+	switch(frame->next_arg)
+	{
+		case 1:     // after the condition
+			frame->jump = emit_jump(prog, OP_JZ);
+			break;
+
+		case 2:     // after the true value
+		{
+			end_branch(prog, temp_nodes, frame->first_temp);
+			int jump_end = emit_jump(prog, OP_JMP);
+			patch_jump(prog, frame->jump);
+			frame->jump = jump_end;
+
+			// the false value starts at the same stack depth
+			--prog->cur_stack;
+			break;
+		}
+
+		case 3:     // after the false value
+			end_branch(prog, temp_nodes, frame->first_temp);
+			patch_jump(prog, frame->jump);
+			break;
+	}
+
+	frame->first_temp = prog->num_temps;
+}
+
+
+static void gen_node(struct AstNode* node, struct ExprProgram* prog, struct AstNode** temp_nodes)
+{
+	switch(node->type)
+	{
+		case AST_VALUE:
+			emit_value(prog, node->val);
+			break;
+		case AST_VAR:
+			emit_symbol(prog, OP_LOAD, node->name, node->name_len);
+			break;
+		case AST_ASSIGN:
+			emit_symbol(prog, OP_STORE, node->name, node->name_len);
+			break;
+		case AST_UNARY:
+		case AST_BINARY:
+			emit_op(prog, node->op);
+			break;
+		case AST_CALL:
+			emit_call(prog, node->op, node->func, node->num_args, node->pure);
+			break;
+		case AST_PARAM:
+			emit_param(prog, node->op);
+			break;
+		case AST_USER_CALL:
+			emit_user_call(prog, node->ufunc, node->num_args);
+			break;
+		case AST_IF:
+			// the jumps are emitted by gen_branch()
+			break;
+	}
+
+	// keep the values of subexpressions which are used more than once
+	if(node->refs > 1 && node->type != AST_VALUE && prog->num_temps < EXPR_MAX_TEMPS)
+	{
+		node->temp = prog->num_temps++;
+		temp_nodes[node->temp] = node;
+		emit_temp(prog, OP_TSTORE, node->temp);
+	}
+}
+
+
+/**
+ * emit the nodes in post-order, the stack depth is bounded
+ * by the number of nodes since the graph is acyclic
+ */
+static void gen(struct AstNode* root, struct ExprProgram* prog, struct GenFrame* stack)
+{
+	struct AstNode *temp_nodes[EXPR_MAX_TEMPS];
+
+	u32 sp = 0;
+	stack[sp].node = root;
+	stack[sp].next_arg = 0;
+	++sp;
+
+	while(sp)
+	{
+		struct GenFrame *frame = stack + sp-1;
+		struct AstNode *node = frame->node;
+
+		// already calculated common subexpression
+		if(frame->next_arg == 0 && node->temp >= 0)
+		{
+			emit_temp(prog, OP_TLOAD, node->temp);
+			--sp;
+			continue;
+		}
+
+		if(node->type == AST_IF && frame->next_arg > 0)
+			gen_branch(frame, prog, temp_nodes);
+
+		if(frame->next_arg < node->num_args)
+		{
+			stack[sp].node = node->args[frame->next_arg++];
+			stack[sp].next_arg = 0;
+			++sp;
+			continue;
+		}
+
+		gen_node(node, prog, temp_nodes);
+		--sp;
+	}
+}
+
+
+/**
+ * @return 0 if the traversal stacks cannot be allocated
+ */
+int ast_codegen(struct AstBuilder* builder, struct AstNode* root, struct ExprProgram* prog)
+{
+	u32 num_nodes = builder->num_nodes ? builder->num_nodes : 1;
+	struct AstNode **refs_stack = (struct AstNode**)arena_alloc(builder->arena,
+		num_nodes * sizeof(struct AstNode*));
+	struct GenFrame *gen_stack = (struct GenFrame*)arena_alloc(builder->arena,
+		num_nodes * sizeof(struct GenFrame));
+	if(!refs_stack || !gen_stack)
+		return 0;
+
+	root->refs = 1;
+	root->visited = 1;
+	count_refs(root, refs_stack);
+
+	gen(root, prog, gen_stack);
+	return 1;
+}
+// ----------------------------------------------------------------------------
@@ -0,0 +1,101 @@
+/**
+ * syntax tree of parsed expressions and its optimisation
+ *
+ * @author agent
+ * @date 16-oct-2026
+ * @license GPLv3, see 'LICENSE' file
+ */
+
+#ifndef __EXPR_AST_H__
+#define __EXPR_AST_H__
+
+#include "string.h"
+#include "expr_parser.h"
+#include "expr_funcs.h"
+#include "expr_code.h"
+
+
+enum AstType
+{
+	AST_VALUE,
+	AST_VAR,
+	AST_ASSIGN,
+	AST_UNARY,
+	AST_BINARY,
+	AST_CALL,
+	AST_PARAM,
+	AST_USER_CALL,
+	AST_IF,
+};
+
+
+struct AstNode
+{
+	int type;
+	int op;                 // AST_UNARY, AST_BINARY: opcode, AST_CALL: arity index,
+	                        // AST_PARAM: parameter index
+	t_value val;            // AST_VALUE
+
+	const char *name;       // AST_VAR, AST_ASSIGN: span in the input
+	int name_len;
+	int epoch;              // AST_VAR: number of preceding assignments
+
+	union Func func;        // AST_CALL
+	struct UserFunc *ufunc; // AST_USER_CALL
+	int pure;
+	int reads_vars;         // the value depends on variables
+
+	struct AstNode **args;
+	struct AstNode *inline_args[2];
+	int num_args;
+
+	u64 hash;
+	int refs;               // number of references from parent nodes
+	int temp;               // temporary slot holding the node's value, -1: none
+	int visited;
+};
+
+
+/**
+ * creates nodes, folding constants, simplifying identities
+ * and merging identical subtrees into one node
+ */
+struct AstBuilder
+{
+	// all nodes are released at once by resetting the arena
+	struct Arena *arena;
+	struct Pool node_pool;
+	u32 num_nodes;
+
+	// hash table of side-effect-free nodes
+	struct AstNode **table;
+	u32 table_cap, table_len;
+
+	// assignment counter, variables are only merged within the same epoch
+	int epoch;
+};
+
+
+extern void init_ast_builder(struct AstBuilder* builder, struct Arena* arena);
+extern void deinit_ast_builder(struct AstBuilder* builder);
+
+extern struct AstNode* ast_value(struct AstBuilder* builder, t_value val);
+extern struct AstNode* ast_var(struct AstBuilder* builder, const char* name, int len);
+extern struct AstNode* ast_assign(struct AstBuilder* builder, const char* name, int len,
+	struct AstNode* val);
+extern struct AstNode* ast_unary(struct AstBuilder* builder, int op, struct AstNode* arg);
+extern struct AstNode* ast_binary(struct AstBuilder* builder, int op,
+	struct AstNode* lhs, struct AstNode* rhs);
+extern struct AstNode* ast_call(struct AstBuilder* builder, int arity, union Func func,
+	int pure, struct AstNode** args, int num_args);
+
+extern struct AstNode* ast_param(struct AstBuilder* builder, int param);
+extern struct AstNode* ast_user_call(struct AstBuilder* builder, struct UserFunc* func,
+	int pure, struct AstNode** args, int num_args);
+extern struct AstNode* ast_if(struct AstBuilder* builder, struct AstNode* cond,
+	struct AstNode* val_true, struct AstNode* val_false);
+
+extern int ast_codegen(struct AstBuilder* builder, struct AstNode* root, struct ExprProgram* prog);
+
+
+#endif
@@ -0,0 +1,618 @@
+/**
+ * bytecode for compiled expressions
+ *
+ * @author agent
+ * @date 16-oct-2026
+ * @license GPLv3, see 'LICENSE' file
+ */
+
+#include <stdlib.h>
+#include <math.h>
+
+#include "expr_code.h"
+#include "expr_jit.h"
+
+
+// ----------------------------------------------------------------------------
+// programs
+// ----------------------------------------------------------------------------
+
+struct ExprProgram* create_program(const struct ExprAllocator* alloc)
+{
+	struct ExprProgram *prog = (struct ExprProgram*)expr_alloc(alloc, sizeof(struct ExprProgram));
+	if(!prog)
+		return 0;
+
+	prog->alloc = alloc;
+
+	prog->code = 0;
+	prog->code_len = prog->code_cap = 0;
+	prog->names = 0;
+	prog->names_len = prog->names_cap = 0;
+	prog->cur_stack = prog->max_stack = 0;
+	prog->num_temps = 0;
+	prog->impure_calls = 0;
+	prog->error = EXPR_OK;
+	prog->refs = 1;
+	prog->jit = 0;
+	prog->jit_code = 0;
+
+	return prog;
+}
+
+
+/**
+ * release the program, it is freed once its last owner releases it
+ */
+void free_program(struct ExprProgram* prog)
+{
+	if(!prog || --prog->refs > 0)
+		return;
+
+	jit_free(prog->jit, prog->jit_code);
+	expr_free(prog->alloc, prog->code);
+	expr_free(prog->alloc, prog->names);
+	expr_free(prog->alloc, prog);
+}
+
+
+/**
+ * keep the first error
+ */
+static void set_error(struct ExprProgram* prog, int code)
+{
+	if(!prog->error)
+		prog->error = code;
+}
+
+
+/**
+ * append an instruction and keep track of the stack depth
+ */
+static struct ExprInstr* emit(struct ExprProgram* prog, int op, int stack_change)
+{
+	if(prog->code_len >= prog->code_cap)
+	{
+		int new_cap = prog->code_cap ? prog->code_cap*2 : 16;
+		struct ExprInstr *new_code = (struct ExprInstr*)expr_realloc(prog->alloc,
+			prog->code, new_cap*sizeof(struct ExprInstr));
+		if(!new_code)
+		{
+			set_error(prog, EXPR_ERR_MEMORY);
+			return 0;
+		}
+
+		prog->code = new_code;
+		prog->code_cap = new_cap;
+	}
+
+	prog->cur_stack += stack_change;
+	if(prog->cur_stack > prog->max_stack)
+		prog->max_stack = prog->cur_stack;
+	if(prog->cur_stack > EXPR_MAX_STACK)
+		set_error(prog, EXPR_ERR_NESTING);
+
+	struct ExprInstr *instr = prog->code + prog->code_len++;
+	instr->op = op;
+	return instr;
+}
+
+
+void emit_op(struct ExprProgram* prog, int op)
+{
+	int stack_change = 0;
+	switch(op)
+	{
+		case OP_ADD: case OP_SUB: case OP_MUL:
+		case OP_DIV: case OP_MOD: case OP_POW:
+			stack_change = -1;
+			break;
+	}
+
+	emit(prog, op, stack_change);
+}
+
+
+void emit_value(struct ExprProgram* prog, t_value val)
+{
+	struct ExprInstr *instr = emit(prog, OP_PUSH, 1);
+	if(instr)
+		instr->arg.val = val;
+}
+
+
+void emit_symbol(struct ExprProgram* prog, int op, const char* name, int name_len)
+{
+	struct ExprInstr *instr = emit(prog, op, op == OP_LOAD ? 1 : 0);
+	if(!instr)
+		return;
+
+	int len = name_len + 1;
+	if(prog->names_len + len > prog->names_cap)
+	{
+		int new_cap = prog->names_cap ? prog->names_cap*2 : 64;
+		while(new_cap < prog->names_len + len)
+			new_cap *= 2;
+
+		char *new_names = (char*)expr_realloc(prog->alloc, prog->names, new_cap);
+		if(!new_names)
+		{
+			set_error(prog, EXPR_ERR_MEMORY);
+			return;
+		}
+
+		prog->names = new_names;
+		prog->names_cap = new_cap;
+	}
+
+	my_strncpy(prog->names + prog->names_len, name, name_len);
+	prog->names[prog->names_len + name_len] = 0;
+	instr->arg.name = prog->names_len;
+	prog->names_len += len;
+}
+
+
+void emit_temp(struct ExprProgram* prog, int op, int temp)
+{
+	struct ExprInstr *instr = emit(prog, op, op == OP_TLOAD ? 1 : 0);
+	if(instr)
+		instr->arg.temp = temp;
+}
+
+
+/**
+ * emit a function call
+ * @param arity arity index of the function as returned by find_func()
+ * @param pure the call only depends on its arguments
+ */
+void emit_call(struct ExprProgram* prog, int arity, union Func func, int num_args, int pure)
+{
+	static const int ops[FUNC_ARITIES] = { OP_CALL0, OP_CALL1, OP_CALL2, OP_CALLN };
+
+	struct ExprInstr *instr = emit(prog, ops[arity], 1 - num_args);
+	if(!instr)
+		return;
+
+	instr->num_args = num_args;
+	instr->arg.func = func;
+	if(!pure)
+		prog->impure_calls = 1;
+}
+
+
+void emit_param(struct ExprProgram* prog, int param)
+{
+	struct ExprInstr *instr = emit(prog, OP_ARG, 1);
+	if(instr)
+		instr->arg.param = param;
+}
+
+
+void emit_user_call(struct ExprProgram* prog, struct UserFunc* func, int num_args)
+{
+	struct ExprInstr *instr = emit(prog, OP_CALLU, 1 - num_args);
+	if(!instr)
+		return;
+
+	instr->num_args = num_args;
+	instr->arg.ufunc = func;
+}
+
+
+/**
+ * emit a jump whose target is set later using patch_jump()
+ * @return index of the jump instruction, -1 on error
+ */
+int emit_jump(struct ExprProgram* prog, int op)
+{
+	struct ExprInstr *instr = emit(prog, op, op == OP_JZ ? -1 : 0);
+	if(!instr)
+		return -1;
+
+	instr->arg.target = 0;
+	return prog->code_len - 1;
+}
+
+
+/**
+ * let the jump continue at the next instruction to be emitted
+ */
+void patch_jump(struct ExprProgram* prog, int instr_idx)
+{
+	if(instr_idx >= 0)
+		prog->code[instr_idx].arg.target = prog->code_len;
+}
+// ----------------------------------------------------------------------------
+
+
+
+// ----------------------------------------------------------------------------
+// interpreter
+// ----------------------------------------------------------------------------
+
+/**
+ * enter a user-defined function, keeping its frame on the context's call stack
+ * @return 0 if the calls are nested too deeply
+ */
+static struct CallFrame* push_call(struct ParserContext* ctx, u32 depth,
+	u32 values_used, const struct UserFunc* func)
+{
+	if(!ctx->calls)
+	{
+		ctx->calls = (struct CallStack*)expr_alloc(&ctx->alloc, sizeof(struct CallStack));
+		if(!ctx->calls)
+		{
+			report_error(ctx, EXPR_ERR_MEMORY, -1, 0, func->name, func->name_len);
+			return 0;
+		}
+	}
+
+	const struct ExprProgram *body = func->prog;
+	if(depth >= EXPR_MAX_CALLS
+		|| values_used + body->max_stack + body->num_temps > EXPR_CALL_STACK)
+	{
+		report_error(ctx, EXPR_ERR_RECURSION, -1, 0, func->name, func->name_len);
+		return 0;
+	}
+
+	return ctx->calls->frames + depth;
+}
+
+
+/**
+ * run a program, or the body of a user-defined function if args are given;
+ * calls of user-defined functions are executed within the loop, not recursively
+ */
+static t_value exec_program(struct ParserContext* ctx, const struct ExprProgram* prog,
+	const t_value* args)
+{
+	t_value stack_outer[EXPR_MAX_STACK];
+	t_value temps_outer[EXPR_MAX_TEMPS];
+	t_value *stack = stack_outer;
+	t_value *temps = temps_outer;
+	int sp = 0;
+
+	u32 depth = 0;          // number of active calls
+	u32 values_used = 0;    // call stack values used by their frames
+
+	for(const struct ExprInstr *instr = prog->code; ; ++instr)
+	{
+		switch(instr->op)
+		{
+			case OP_END:
+			{
+				t_value result = sp ? stack[sp-1] : 0;
+				if(!depth)
+					return result;
+
+				// return to the caller
+				const struct CallFrame *frame = ctx->calls->frames + --depth;
+				memo_store(frame->func, args, result);
+
+				prog = frame->prog;
+				instr = frame->instr;
+				stack = frame->stack;
+				temps = frame->temps;
+				args = frame->args;
+				sp = frame->sp;
+				values_used = frame->values_used;
+
+				stack[sp++] = result;
+				break;
+			}
+
+			case OP_PUSH:
+				stack[sp++] = instr->arg.val;
+				break;
+
+			case OP_LOAD:
+			{
+				const char *name = prog->names + instr->arg.name;
+				const struct Symbol *sym = find_symbol(ctx, name);
+				if(!sym)
+				{
+					report_error(ctx, EXPR_ERR_UNKNOWN_IDENT, -1, 0, name, my_strlen(name));
+					return 0;
+				}
+
+				stack[sp++] = sym->value;
+				break;
+			}
+
+			case OP_STORE:
+				assign_or_insert_symbol(ctx, prog->names + instr->arg.name, stack[sp-1]);
+				break;
+
+			case OP_ADD:
+				--sp;
+				stack[sp-1] = stack[sp-1] + stack[sp];
+				break;
+
+			case OP_SUB:
+				--sp;
+				stack[sp-1] = stack[sp-1] - stack[sp];
+				break;
+
+			case OP_MUL:
+				--sp;
+				stack[sp-1] = stack[sp-1] * stack[sp];
+				break;
+
+			case OP_DIV:
+				--sp;
+				stack[sp-1] = stack[sp-1] / stack[sp];
+				break;
+
+			case OP_MOD:
+				--sp;
+				stack[sp-1] = fmod(stack[sp-1], stack[sp]);
+				break;
+
+			case OP_POW:
+				--sp;
+				stack[sp-1] = pow(stack[sp-1], stack[sp]);
+				break;
+
+			case OP_NEG:
+				stack[sp-1] = -stack[sp-1];
+				break;
+
+			case OP_CALL0:
+				stack[sp++] = (*instr->arg.func.f0)();
+				break;
+
+			case OP_CALL1:
+				stack[sp-1] = (*instr->arg.func.f1)(stack[sp-1]);
+				break;
+
+			case OP_CALL2:
+				--sp;
+				stack[sp-1] = (*instr->arg.func.f2)(stack[sp-1], stack[sp]);
+				break;
+
+			case OP_CALLN:
+				sp -= instr->num_args;
+				stack[sp] = (*instr->arg.func.fn)(stack + sp, instr->num_args);
+				++sp;
+				break;
+
+			case OP_TSTORE:
+				temps[instr->arg.temp] = stack[sp-1];
+				break;
+
+			case OP_TLOAD:
+				stack[sp++] = temps[instr->arg.temp];
+				break;
+
+			case OP_ARG:
+				stack[sp++] = args[instr->arg.param];
+				break;
+
+			case OP_CALLU:
+			{
+				struct UserFunc *func = instr->arg.ufunc;
+				sp -= instr->num_args;
+
+				// the function might have been redefined with other parameters
+				if(!func->prog || func->num_params != instr->num_args)
+				{
+					report_error(ctx, EXPR_ERR_UNKNOWN_FUNC, -1, 0, func->name, func->name_len);
+					return 0;
+				}
+
+				t_value result;
+				if(memo_lookup(func, stack + sp, &result))
+				{
+					stack[sp++] = result;
+					break;
+				}
+
+				struct CallFrame *frame = push_call(ctx, depth, values_used, func);
+				if(!frame)
+					return 0;
+				++depth;
+
+				frame->prog = prog;
+				frame->instr = instr;
+				frame->stack = stack;
+				frame->temps = temps;
+				frame->args = args;
+				frame->sp = sp;
+				frame->func = func;
+				frame->values_used = values_used;
+
+				// the arguments stay in the caller's stack until the call returns
+				args = stack + sp;
+				prog = func->prog;
+				stack = ctx->calls->values + values_used;
+				temps = stack + prog->max_stack;
+				values_used += prog->max_stack + prog->num_temps;
+				sp = 0;
+
+				instr = prog->code - 1;
+				break;
+			}
+
+			case OP_JZ:
+				if(stack[--sp] == 0)
+					instr = prog->code + instr->arg.target - 1;
+				break;
+
+			case OP_JMP:
+				instr = prog->code + instr->arg.target - 1;
+				break;
+
+			default:
+				report_error(ctx, EXPR_ERR_INTERNAL, -1, 0, 0, 0);
+				return 0;
+		}
+	}
+
+	// should not get here
+	return 0;
+}
+
+
+t_value run_program(struct ParserContext* ctx, const struct ExprProgram* prog)
+{
+	if(!prog || prog->error)
+		return 0;
+	if(prog->jit_code)
+		return (*(t_jitfunc)prog->jit_code)(ctx);
+
+	return exec_program(ctx, prog, 0);
+}
+
+
+/**
+ * call a user-defined function from outside of a program
+ */
+t_value call_user_func(struct ParserContext* ctx, struct UserFunc* func,
+	const t_value* args, int num_args)
+{
+	if(!func->prog || func->num_params != num_args)
+	{
+		report_error(ctx, EXPR_ERR_UNKNOWN_FUNC, -1, 0, func->name, func->name_len);
+		return 0;
+	}
+
+	t_value result;
+	if(memo_lookup(func, args, &result))
+		return result;
+
+	u32 diags_before = ctx->diags.count;
+	result = exec_program(ctx, func->prog, args);
+	if(ctx->diags.count == diags_before)
+		memo_store(func, args, result);
+	return result;
+}
+// ----------------------------------------------------------------------------
+
+
+
+// ----------------------------------------------------------------------------
+// lru cache of compiled programs, keyed by their source text
+// ----------------------------------------------------------------------------
+
+struct ExprCache* create_cache(const struct ExprAllocator* alloc)
+{
+	struct ExprCache *cache = (struct ExprCache*)expr_alloc(alloc, sizeof(struct ExprCache));
+	if(!cache)
+		return 0;
+
+	cache->alloc = alloc;
+
+	for(int i=0; i<EXPR_CACHE_SIZE; ++i)
+	{
+		struct ExprCacheEntry *entry = cache->entries + i;
+		entry->hash = 0;
+		entry->source = 0;
+		entry->prog = 0;
+		entry->last_used = 0;
+	}
+
+	cache->tick = 0;
+	return cache;
+}
+
+
+void free_cache(struct ExprCache* cache)
+{
+	if(!cache)
+		return;
+
+	clear_cache(cache);
+	expr_free(cache->alloc, cache);
+}
+
+
+/**
+ * remove all programs, e.g. if the functions they were compiled against have changed
+ */
+void clear_cache(struct ExprCache* cache)
+{
+	if(!cache)
+		return;
+
+	for(int i=0; i<EXPR_CACHE_SIZE; ++i)
+	{
+		struct ExprCacheEntry *entry = cache->entries + i;
+
+		expr_free(cache->alloc, entry->source);
+		free_program(entry->prog);
+
+		entry->hash = 0;
+		entry->source = 0;
+		entry->prog = 0;
+		entry->last_used = 0;
+	}
+}
+
+
+struct ExprProgram* cache_lookup(struct ExprCache* cache, const char* source)
+{
+	if(!cache)
+		return 0;
+
+	u64 hash = my_strhash(source);
+
+	for(int i=0; i<EXPR_CACHE_SIZE; ++i)
+	{
+		struct ExprCacheEntry *entry = cache->entries + i;
+		if(!entry->prog || entry->hash != hash)
+			continue;
+		if(my_strcmp(entry->source, source) != 0)
+			continue;
+
+		entry->last_used = ++cache->tick;
+		return entry->prog;
+	}
+
+	return 0;
+}
+
+
+/**
+ * insert a program into the cache, taking ownership of it
+ * and evicting the least recently used entry if needed
+ */
+void cache_insert(struct ExprCache* cache, const char* source, struct ExprProgram* prog)
+{
+	if(!cache)
+	{
+		free_program(prog);
+		return;
+	}
+
+	struct ExprCacheEntry *lru = cache->entries;
+	for(int i=0; i<EXPR_CACHE_SIZE; ++i)
+	{
+		struct ExprCacheEntry *entry = cache->entries + i;
+		if(!entry->prog)
+		{
+			lru = entry;
+			break;
+		}
+
+		if(entry->last_used < lru->last_used)
+			lru = entry;
+	}
+
+	int len = my_strlen(source) + 1;
+	char *source_copy = (char*)expr_alloc(cache->alloc, len);
+	if(!source_copy)
+	{
+		free_program(prog);
+		return;
+	}
+	my_strncpy(source_copy, source, len);
+
+	expr_free(cache->alloc, lru->source);
+	free_program(lru->prog);
+
+	lru->hash = my_strhash(source);
+	lru->source = source_copy;
+	lru->prog = prog;
+	lru->last_used = ++cache->tick;
+}
+// ----------------------------------------------------------------------------
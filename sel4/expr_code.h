@@ -0,0 +1,164 @@
+/**
+ * bytecode for compiled expressions
+ *
+ * @author agent
+ * @date 16-oct-2026
+ * @license GPLv3, see 'LICENSE' file
+ */
+
+#ifndef __EXPR_CODE_H__
+#define __EXPR_CODE_H__
+
+#include "string.h"
+#include "expr_parser.h"
+#include "expr_funcs.h"
+
+
+#define EXPR_MAX_STACK  32      // maximum operand stack depth of a program
+#define EXPR_MAX_TEMPS  16      // maximum number of common subexpressions kept in a program
+#define EXPR_CACHE_SIZE 32      // number of compiled programs to keep
+#define EXPR_MAX_CALLS  128     // maximum nesting of user-defined function calls
+#define EXPR_CALL_STACK 2048    // values available to the frames of nested calls
+
+
+enum OpCode
+{
+	OP_END   = 0,   // end of program, result is on top of the stack
+
+	OP_PUSH  = 1,   // push constant
+	OP_LOAD  = 2,   // push variable
+	OP_STORE = 3,   // assign top of stack to variable, leaving it on the stack
+
+	OP_ADD   = 4,
+	OP_SUB   = 5,
+	OP_MUL   = 6,
+	OP_DIV   = 7,
+	OP_MOD   = 8,
+	OP_POW   = 9,
+	OP_NEG   = 10,
+
+	OP_CALL0 = 11,  // call function without arguments
+	OP_CALL1 = 12,  // call one-argument function
+	OP_CALL2 = 13,  // call two-argument function
+	OP_CALLN = 14,  // call n-ary function
+
+	OP_TSTORE = 15, // copy top of stack into a temporary slot
+	OP_TLOAD  = 16, // push temporary slot
+
+	OP_ARG   = 17,  // push argument of a user-defined function
+	OP_CALLU = 18,  // call user-defined function
+	OP_JZ    = 19,  // pop value and jump if it is zero
+	OP_JMP   = 20,  // jump
+};
+
+
+struct ExprInstr
+{
+	int op;
+	int num_args;       // OP_CALLN
+
+	union
+	{
+		t_value val;    // OP_PUSH
+		int name;       // OP_LOAD, OP_STORE: offset into the name pool
+		int temp;       // OP_TSTORE, OP_TLOAD: temporary slot
+		int param;      // OP_ARG: parameter index
+		int target;     // OP_JZ, OP_JMP: instruction index
+		union Func func;// OP_CALL0 to OP_CALLN
+		struct UserFunc *ufunc; // OP_CALLU
+	} arg;
+};
+
+
+struct ExprProgram
+{
+	struct ExprInstr *code;
+	int code_len, code_cap;
+
+	// '\0'-separated identifier names
+	char *names;
+	int names_len, names_cap;
+
+	int cur_stack, max_stack;
+	int num_temps;
+	int impure_calls;   // calls functions which may have effects, e.g. ones of the embedder
+	int error;          // first error, EXPR_OK if none
+	int refs;           // owners of the program, e.g. the cache and a variable's formula
+
+	const struct ExprAllocator *alloc;
+
+	// native code, see expr_jit.c
+	struct JitBuffer *jit;
+	void *jit_code;
+};
+
+
+/**
+ * caller state saved when calling a user-defined function
+ */
+struct CallFrame
+{
+	const struct ExprProgram *prog;
+	const struct ExprInstr *instr;
+	t_value *stack, *temps;
+	const t_value *args;
+	int sp;
+
+	struct UserFunc *func;  // called function
+	u32 values_used;        // call stack values used by the caller
+};
+
+
+/**
+ * frames of user-defined function calls, which do not use the native stack
+ */
+struct CallStack
+{
+	struct CallFrame frames[EXPR_MAX_CALLS];
+	t_value values[EXPR_CALL_STACK];
+};
+
+
+struct ExprCacheEntry
+{
+	u64 hash;
+	char *source;
+	struct ExprProgram *prog;
+	u64 last_used;
+};
+
+
+struct ExprCache
+{
+	struct ExprCacheEntry entries[EXPR_CACHE_SIZE];
+	u64 tick;
+
+	const struct ExprAllocator *alloc;
+};
+
+
+extern struct ExprProgram* create_program(const struct ExprAllocator* alloc);
+extern void free_program(struct ExprProgram* prog);
+
+extern void emit_op(struct ExprProgram* prog, int op);
+extern void emit_value(struct ExprProgram* prog, t_value val);
+extern void emit_symbol(struct ExprProgram* prog, int op, const char* name, int len);
+extern void emit_temp(struct ExprProgram* prog, int op, int temp);
+extern void emit_call(struct ExprProgram* prog, int arity, union Func func, int num_args, int pure);
+extern void emit_param(struct ExprProgram* prog, int param);
+extern void emit_user_call(struct ExprProgram* prog, struct UserFunc* func, int num_args);
+extern int emit_jump(struct ExprProgram* prog, int op);
+extern void patch_jump(struct ExprProgram* prog, int instr_idx);
+
+extern t_value run_program(struct ParserContext* ctx, const struct ExprProgram* prog);
+extern t_value call_user_func(struct ParserContext* ctx, struct UserFunc* func,
+	const t_value* args, int num_args);
+
+extern struct ExprCache* create_cache(const struct ExprAllocator* alloc);
+extern void free_cache(struct ExprCache* cache);
+extern void clear_cache(struct ExprCache* cache);
+extern struct ExprProgram* cache_lookup(struct ExprCache* cache, const char* source);
+extern void cache_insert(struct ExprCache* cache, const char* source, struct ExprProgram* prog);
+
+
+#endif
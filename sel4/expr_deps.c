@@ -0,0 +1,594 @@
+/**
+ * dependency graph of variables defined by formulas
+ *
+ * an assignment like "x = a*b" keeps its program as the formula of x;
+ * if a or b change later, x and the variables depending on it are recomputed
+ * in topological order, visiting only the affected part of the graph;
+ * formulas are compiled again from their source once the functions or
+ * constants which were resolved when compiling them may have changed
+ *
+ * @author agent
+ * @date 16-oct-2026
+ * @license GPLv3, see 'LICENSE' file
+ *
+ * References:
+ *	- https://en.wikipedia.org/wiki/Topological_sorting#Kahn's_algorithm
+ *	- https://en.wikipedia.org/wiki/Reactive_programming
+ */
+
+#include "expr_deps.h"
+#include "expr_funcs.h"
+
+
+// ----------------------------------------------------------------------------
+// graph
+// ----------------------------------------------------------------------------
+
+struct DepGraph* create_dep_graph(const struct ExprAllocator* alloc)
+{
+	struct DepGraph *graph = (struct DepGraph*)expr_alloc(alloc, sizeof(struct DepGraph));
+	if(!graph)
+		return 0;
+
+	graph->nodes = 0;
+	graph->num_nodes = 0;
+	graph->changed = 0;
+	graph->num_changed = graph->changed_cap = 0;
+	graph->stamp = 0;
+	graph->updating = 0;
+	graph->stale = 0;
+	graph->alloc = alloc;
+
+	return graph;
+}
+
+
+static void release_formula(struct DepGraph* graph, struct DepNode* node)
+{
+	free_program(node->formula);
+	expr_free(graph->alloc, node->text);
+	expr_free(graph->alloc, node->deps);
+
+	node->formula = 0;
+	node->text = 0;
+	node->deps = 0;
+	node->num_deps = 0;
+}
+
+
+void free_dep_graph(struct DepGraph* graph)
+{
+	if(!graph)
+		return;
+
+	for(u32 i=0; i<graph->num_nodes; ++i)
+	{
+		struct DepNode *node = graph->nodes + i;
+		release_formula(graph, node);
+		expr_free(graph->alloc, node->users);
+	}
+
+	expr_free(graph->alloc, graph->nodes);
+	expr_free(graph->alloc, graph->changed);
+	expr_free(graph->alloc, graph);
+}
+
+
+/**
+ * make room for the nodes of the first num symbols, at most max_num
+ */
+static int grow_nodes(struct DepGraph* graph, u32 num, u32 max_num)
+{
+	if(num <= graph->num_nodes)
+		return 1;
+
+	u32 new_num = my_max(num, graph->num_nodes*2);
+	if(new_num > max_num)
+		new_num = max_num;
+	struct DepNode *nodes = (struct DepNode*)expr_realloc(graph->alloc,
+		graph->nodes, new_num * sizeof(struct DepNode));
+	if(!nodes)
+		return 0;
+
+	my_memset((i8*)(nodes + graph->num_nodes), 0,
+		(new_num - graph->num_nodes) * sizeof(struct DepNode));
+
+	graph->nodes = nodes;
+	graph->num_nodes = new_num;
+	return 1;
+}
+
+
+static int add_user(struct DepGraph* graph, struct DepNode* node, u32 user)
+{
+	if(node->num_users >= node->users_cap)
+	{
+		u32 new_cap = node->users_cap ? node->users_cap*2 : 4;
+		u32 *users = (u32*)expr_realloc(graph->alloc, node->users, new_cap * sizeof(u32));
+		if(!users)
+			return 0;
+
+		node->users = users;
+		node->users_cap = new_cap;
+	}
+
+	node->users[node->num_users++] = user;
+	return 1;
+}
+
+
+static void remove_user(struct DepNode* node, u32 user)
+{
+	for(u32 i=0; i<node->num_users; ++i)
+	{
+		if(node->users[i] == user)
+		{
+			node->users[i] = node->users[--node->num_users];
+			return;
+		}
+	}
+}
+
+
+/**
+ * turn a variable back into a plain value
+ */
+static void unlink_formula(struct DepGraph* graph, u32 idx)
+{
+	struct DepNode *node = graph->nodes + idx;
+	for(u32 i=0; i<node->num_deps; ++i)
+		remove_user(graph->nodes + node->deps[i], idx);
+
+	release_formula(graph, node);
+}
+// ----------------------------------------------------------------------------
+
+
+
+// ----------------------------------------------------------------------------
+// recording formulas
+// ----------------------------------------------------------------------------
+
+/**
+ * find the variables read by a formula, including those read by the
+ * user-defined functions it calls, the found nodes get the given mark
+ * @return number of variables, -1 if the program assigns other variables
+ */
+static int collect_deps(struct ParserContext* ctx, struct DepGraph* graph,
+	const struct ExprProgram* prog, u32 mark, u32* deps,
+	const struct ExprProgram** bodies, int* calls_user)
+{
+	u32 num_deps = 0, num_bodies = 0;
+	int num_stores = 0;
+
+	bodies[num_bodies++] = prog;
+	for(u32 body_idx=0; body_idx<num_bodies; ++body_idx)
+	{
+		const struct ExprProgram *body = bodies[body_idx];
+
+		for(int i=0; i<body->code_len; ++i)
+		{
+			const struct ExprInstr *instr = body->code + i;
+
+			if(instr->op == OP_STORE && ++num_stores > 1)
+				return -1;
+
+			else if(instr->op == OP_LOAD)
+			{
+				const struct Symbol *sym = find_symbol(ctx, body->names + instr->arg.name);
+				if(!sym)
+					return -1;
+
+				u32 idx = sym - ctx->symboltable.syms;
+				if(!grow_nodes(graph, idx + 1, ctx->symboltable.num_syms))
+				{
+					report_error(ctx, EXPR_ERR_MEMORY, -1, 0, 0, 0);
+					return -1;
+				}
+
+				struct DepNode *node = graph->nodes + idx;
+				if(node->mark != mark)
+				{
+					node->mark = mark;
+					deps[num_deps++] = idx;
+				}
+			}
+
+			else if(instr->op == OP_CALLU)
+			{
+				*calls_user = 1;
+
+				// pure functions don't read any variables
+				const struct UserFunc *func = instr->arg.ufunc;
+				if(func->pure || !func->prog)
+					continue;
+
+				u32 known = 0;
+				while(known < num_bodies && bodies[known] != func->prog)
+					++known;
+				if(known == num_bodies)
+					bodies[num_bodies++] = func->prog;
+			}
+		}
+	}
+
+	return num_deps;
+}
+
+
+/**
+ * check if a program reads variables, directly or in the user-defined functions it calls
+ */
+static int reads_symbols(const struct ExprProgram* prog)
+{
+	for(int i=0; i<prog->code_len; ++i)
+	{
+		const struct ExprInstr *instr = prog->code + i;
+		if(instr->op == OP_LOAD || instr->op == OP_CALLU)
+			return 1;
+	}
+
+	return 0;
+}
+
+
+/**
+ * check if a variable is read by one of the given dependencies, directly or indirectly
+ */
+static int reaches_mark(struct DepGraph* graph, u32 idx, u32 mark, u32* stack)
+{
+	if(graph->nodes[idx].mark == mark)
+		return 1;
+
+	u32 visited = ++graph->stamp;
+	u32 num = 0;
+
+	graph->nodes[idx].mark = visited;
+	stack[num++] = idx;
+
+	while(num)
+	{
+		const struct DepNode *node = graph->nodes + stack[--num];
+		for(u32 i=0; i<node->num_users; ++i)
+		{
+			struct DepNode *user = graph->nodes + node->users[i];
+			if(user->mark == mark)
+				return 1;
+			if(user->mark == visited)
+				continue;
+
+			user->mark = visited;
+			stack[num++] = node->users[i];
+		}
+	}
+
+	return 0;
+}
+
+
+/**
+ * keep the program of a top-level assignment as the formula of its variable;
+ * programs assigning several variables and circular definitions like "n = n + 1"
+ * only assign a value
+ * @param text source of the program
+ */
+void dep_record_formula(struct ParserContext* ctx, struct ExprProgram* prog, const char* text)
+{
+	if(!prog || prog->error || prog->code_len < 2)
+		return;
+
+	const struct ExprInstr *store = prog->code + prog->code_len - 2;
+	if(store->op != OP_STORE)
+		return;
+
+	struct SymbolTable *tab = &ctx->symboltable;
+	const struct Symbol *sym = find_symbol(ctx, prog->names + store->arg.name);
+	if(!sym)
+		return;
+	u32 idx = sym - tab->syms;
+
+	// plain values like "v = 5" don't need a node
+	if(!reads_symbols(prog))
+		return;
+
+	if(!ctx->deps)
+		ctx->deps = create_dep_graph(&ctx->alloc);
+
+	struct DepGraph *graph = ctx->deps;
+	if(!graph)
+	{
+		report_error(ctx, EXPR_ERR_MEMORY, -1, 0, 0, 0);
+		return;
+	}
+
+	u32 *deps = (u32*)arena_alloc(&ctx->scratch, tab->num_syms * sizeof(u32));
+	const struct ExprProgram **bodies = (const struct ExprProgram**)arena_alloc(
+		&ctx->scratch, (tab->num_syms + 1) * sizeof(struct ExprProgram*));
+	if(!deps || !bodies)
+	{
+		report_error(ctx, EXPR_ERR_MEMORY, -1, 0, 0, 0);
+		arena_reset(&ctx->scratch);
+		return;
+	}
+
+	int calls_user = 0;
+	u32 mark = ++graph->stamp;
+	int num_deps = collect_deps(ctx, graph, prog, mark, deps, bodies, &calls_user);
+
+	// the dependencies' buffer is reused as the search stack, it is copied before
+	u32 *node_deps = 0;
+	char *node_text = 0;
+	if(num_deps > 0)
+	{
+		// nodes are only needed up to the variables with formulas and their dependencies
+		u32 text_len = my_strlen(text);
+		if(grow_nodes(graph, idx + 1, tab->num_syms))
+		{
+			node_deps = (u32*)expr_alloc(graph->alloc, num_deps * sizeof(u32));
+			node_text = (char*)expr_alloc(graph->alloc, text_len + 1);
+		}
+
+		if(!node_deps || !node_text)
+		{
+			report_error(ctx, EXPR_ERR_MEMORY, -1, 0, 0, 0);
+			expr_free(graph->alloc, node_text);
+			expr_free(graph->alloc, node_deps);
+			node_deps = 0;
+			node_text = 0;
+		}
+		else
+		{
+			my_memcpy((i8*)node_deps, (i8*)deps, num_deps * sizeof(u32));
+			my_memcpy((i8*)node_text, (i8*)text, text_len + 1);
+		}
+	}
+
+	if(!node_deps || reaches_mark(graph, idx, mark, deps))
+	{
+		expr_free(graph->alloc, node_deps);
+		expr_free(graph->alloc, node_text);
+		arena_reset(&ctx->scratch);
+		return;
+	}
+
+	struct DepNode *node = graph->nodes + idx;
+	if(node->formula)
+		unlink_formula(graph, idx);
+
+	for(int i=0; i<num_deps; ++i)
+	{
+		if(!add_user(graph, graph->nodes + node_deps[i], idx))
+		{
+			report_error(ctx, EXPR_ERR_MEMORY, -1, 0, 0, 0);
+			for(int j=0; j<i; ++j)
+				remove_user(graph->nodes + node_deps[j], idx);
+			expr_free(graph->alloc, node_deps);
+			expr_free(graph->alloc, node_text);
+			arena_reset(&ctx->scratch);
+			return;
+		}
+	}
+
+	// the program is shared with the cache
+	++prog->refs;
+	node->formula = prog;
+	node->text = node_text;
+	node->deps = node_deps;
+	node->num_deps = num_deps;
+
+	// formulas share the context when running concurrently: calls of
+	// user-defined functions use its call stack and can fail, the embedder's
+	// functions need not be thread-safe; the remaining ones cannot report errors,
+	// as the variables they read keep their values, and only store their variable
+	node->parallel = !calls_user && !prog->impure_calls;
+
+	arena_reset(&ctx->scratch);
+}
+
+
+/**
+ * turn a variable with a formula back into a plain value, keeping its current value
+ */
+void dep_drop_formula(struct ParserContext* ctx, u32 sym_idx)
+{
+	struct DepGraph *graph = ctx->deps;
+	if(graph && sym_idx < graph->num_nodes && graph->nodes[sym_idx].formula)
+		unlink_formula(graph, sym_idx);
+}
+
+
+/**
+ * note the assignment of a variable, which replaces its formula
+ */
+void dep_assigned(struct ParserContext* ctx, u32 sym_idx)
+{
+	struct DepGraph *graph = ctx->deps;
+	if(!graph || graph->updating || sym_idx >= graph->num_nodes)
+		return;
+
+	struct DepNode *node = graph->nodes + sym_idx;
+	if(node->formula)
+		unlink_formula(graph, sym_idx);
+
+	if(!node->num_users || node->changed)
+		return;
+
+	if(graph->num_changed >= graph->changed_cap)
+	{
+		u32 new_cap = graph->changed_cap ? graph->changed_cap*2 : 16;
+		u32 *changed = (u32*)expr_realloc(graph->alloc, graph->changed, new_cap * sizeof(u32));
+		if(!changed)
+		{
+			report_error(ctx, EXPR_ERR_MEMORY, -1, 0, 0, 0);
+			return;
+		}
+
+		graph->changed = changed;
+		graph->changed_cap = new_cap;
+	}
+
+	graph->changed[graph->num_changed++] = sym_idx;
+	node->changed = 1;
+}
+// ----------------------------------------------------------------------------
+
+
+
+// ----------------------------------------------------------------------------
+// recomputation
+// ----------------------------------------------------------------------------
+
+struct FormulaTask
+{
+	struct ParserContext *ctx;
+	const u32 *vars;
+};
+
+
+static void eval_formula(void* arg, u32 idx)
+{
+	const struct FormulaTask *task = (const struct FormulaTask*)arg;
+	const struct DepNode *node = task->ctx->deps->nodes + task->vars[idx];
+
+	// the program ends by assigning the variable
+	run_program(task->ctx, node->formula);
+}
+
+
+/**
+ * recompute variables which don't depend on each other
+ */
+static void eval_level(struct ParserContext* ctx, u32* vars, u32 num)
+{
+	const struct DepNode *nodes = ctx->deps->nodes;
+
+	// move the formulas which can run concurrently to the front
+	u32 num_parallel = 0;
+	for(u32 i=0; i<num; ++i)
+	{
+		if(!nodes[vars[i]].parallel)
+			continue;
+
+		u32 var = vars[i];
+		vars[i] = vars[num_parallel];
+		vars[num_parallel++] = var;
+	}
+
+	struct FormulaTask task = { .ctx = ctx, .vars = vars };
+	u32 first = 0;
+	if(ctx->pool && num_parallel > 1)
+	{
+		(*ctx->pool->run)(ctx->pool->user, &eval_formula, &task, num_parallel);
+		first = num_parallel;
+	}
+
+	for(u32 i=first; i<num; ++i)
+		eval_formula(&task, i);
+}
+
+
+static void clear_changed(struct DepGraph* graph)
+{
+	for(u32 i=0; i<graph->num_changed; ++i)
+		graph->nodes[graph->changed[i]].changed = 0;
+	graph->num_changed = 0;
+}
+
+
+/**
+ * recompute the variables depending on the ones assigned since the last update
+ */
+void update_dependents(struct ParserContext* ctx)
+{
+	struct DepGraph *graph = ctx->deps;
+	if(!graph || !graph->num_changed || graph->updating)
+		return;
+
+	u32 *order = (u32*)arena_alloc(&ctx->scratch, graph->num_nodes * sizeof(u32));
+	u32 *stack = (u32*)arena_alloc(&ctx->scratch, graph->num_nodes * sizeof(u32));
+	if(!order || !stack)
+	{
+		report_error(ctx, EXPR_ERR_MEMORY, -1, 0, 0, 0);
+		clear_changed(graph);
+		arena_reset(&ctx->scratch);
+		return;
+	}
+
+	// find the affected variables, counting their affected dependencies
+	u32 mark = ++graph->stamp;
+	u32 num_stack = 0;
+	for(u32 i=0; i<graph->num_changed; ++i)
+	{
+		graph->nodes[graph->changed[i]].mark = mark;
+		stack[num_stack++] = graph->changed[i];
+	}
+
+	while(num_stack)
+	{
+		const struct DepNode *node = graph->nodes + stack[--num_stack];
+		for(u32 i=0; i<node->num_users; ++i)
+		{
+			struct DepNode *user = graph->nodes + node->users[i];
+			if(user->changed)
+				continue;
+
+			if(user->mark != mark)
+			{
+				user->mark = mark;
+				user->pending = 0;
+				stack[num_stack++] = node->users[i];
+			}
+
+			++user->pending;
+		}
+	}
+
+	// visit the affected variables level by level, starting with the assigned ones
+	u32 begin = 0, end = 0;
+	for(u32 i=0; i<graph->num_changed; ++i)
+		order[end++] = graph->changed[i];
+
+	graph->updating = 1;
+	while(begin < end)
+	{
+		u32 level = end;
+		for(u32 i=begin; i<level; ++i)
+		{
+			const struct DepNode *node = graph->nodes + order[i];
+			for(u32 j=0; j<node->num_users; ++j)
+			{
+				struct DepNode *user = graph->nodes + node->users[j];
+				if(!user->changed && --user->pending == 0)
+					order[end++] = node->users[j];
+			}
+		}
+
+		eval_level(ctx, order + level, end - level);
+		begin = level;
+	}
+	graph->updating = 0;
+
+	clear_changed(graph);
+	arena_reset(&ctx->scratch);
+}
+
+
+/**
+ * recompute all formulas, starting from the plain values they read
+ */
+void update_all(struct ParserContext* ctx)
+{
+	struct DepGraph *graph = ctx->deps;
+	if(!graph)
+		return;
+
+	for(u32 i=0; i<graph->num_nodes; ++i)
+	{
+		const struct DepNode *node = graph->nodes + i;
+		if(!node->formula && node->num_users)
+			dep_assigned(ctx, i);
+	}
+
+	update_dependents(ctx);
+}
+// ----------------------------------------------------------------------------
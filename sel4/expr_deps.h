@@ -0,0 +1,78 @@
+/**
+ * dependency graph of variables defined by formulas
+ *
+ * @author agent
+ * @date 16-oct-2026
+ * @license GPLv3, see 'LICENSE' file
+ */
+
+#ifndef __EXPR_DEPS_H__
+#define __EXPR_DEPS_H__
+
+#include "string.h"
+#include "expr_parser.h"
+#include "expr_code.h"
+
+
+typedef void (*t_task)(void* arg, u32 idx);
+
+
+/**
+ * worker pool given by the embedder
+ */
+struct ExprTaskPool
+{
+	// call task(arg, idx) for all idx < num, returning when all calls have finished
+	void (*run)(void* user, t_task task, void* arg, u32 num);
+	void *user;
+};
+
+
+/**
+ * variable in the graph, nodes have the same indices as the symbols
+ */
+struct DepNode
+{
+	struct ExprProgram *formula;    // program assigning the variable, 0: plain value
+	char *text;                     // the formula's source, to compile it again
+	int parallel;                   // the formula may run concurrently with others, it cannot fail
+
+	u32 *deps;                      // variables read by the formula
+	u32 num_deps;
+
+	u32 *users;                     // variables whose formulas read this one
+	u32 num_users, users_cap;
+
+	u32 mark;                       // traversal stamp
+	u32 pending;                    // dependencies still to be recomputed
+	int changed;                    // the variable is in the list of changed ones
+};
+
+
+struct DepGraph
+{
+	struct DepNode *nodes;
+	u32 num_nodes;
+
+	u32 *changed;                   // variables assigned since the last update
+	u32 num_changed, changed_cap;
+
+	u32 stamp;
+	int updating;                   // formulas are being recomputed
+	int stale;                      // the formulas' functions or constants may have changed
+
+	const struct ExprAllocator *alloc;
+};
+
+
+extern struct DepGraph* create_dep_graph(const struct ExprAllocator* alloc);
+extern void free_dep_graph(struct DepGraph* graph);
+
+extern void dep_assigned(struct ParserContext* ctx, u32 sym_idx);
+extern void dep_record_formula(struct ParserContext* ctx, struct ExprProgram* prog, const char* text);
+extern void dep_drop_formula(struct ParserContext* ctx, u32 sym_idx);
+extern void update_dependents(struct ParserContext* ctx);
+extern void update_all(struct ParserContext* ctx);
+
+
+#endif
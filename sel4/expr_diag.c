@@ -0,0 +1,131 @@
+/**
+ * error codes and diagnostics of the expression parser
+ *
+ * @author agent
+ * @date 16-oct-2026
+ * @license GPLv3, see 'LICENSE' file
+ */
+
+#include "expr_diag.h"
+#include "expr_parser.h"
+#include "expr_code.h"
+
+
+/**
+ * record an error without any output, it is also
+ * remembered as the program's error while compiling
+ */
+void report_error(struct ParserContext* ctx, int code, int pos, int len,
+	const char* text, int text_len)
+{
+	struct DiagRing *ring = &ctx->diags;
+	struct Diagnostic *diag = ring->entries + ring->count % EXPR_MAX_DIAGS;
+
+	diag->code = code;
+	diag->pos = pos;
+	diag->len = len;
+
+	if(text_len >= EXPR_DIAG_TEXT_LEN)
+		text_len = EXPR_DIAG_TEXT_LEN - 1;
+	if(text && text_len > 0)
+		my_strncpy(diag->text, text, text_len);
+	else
+		text_len = 0;
+	diag->text[text_len] = 0;
+
+	++ring->count;
+	if(ring->count - ring->first > EXPR_MAX_DIAGS)
+		ring->first = ring->count - EXPR_MAX_DIAGS;
+
+	if(ctx->prog && !ctx->prog->error)
+		ctx->prog->error = code;
+}
+
+
+u32 num_diagnostics(const struct ParserContext* ctx)
+{
+	return ctx->diags.count - ctx->diags.first;
+}
+
+
+/**
+ * get a diagnostic, oldest first
+ */
+const struct Diagnostic* get_diagnostic(const struct ParserContext* ctx, u32 idx)
+{
+	if(idx >= num_diagnostics(ctx))
+		return 0;
+
+	return ctx->diags.entries + (ctx->diags.first + idx) % EXPR_MAX_DIAGS;
+}
+
+
+void clear_diagnostics(struct ParserContext* ctx)
+{
+	ctx->diags.first = ctx->diags.count;
+}
+
+
+/**
+ * print and clear the diagnostics, not to be used in the hot path
+ */
+void print_diagnostics(struct ParserContext* ctx)
+{
+	for(u32 i=0; i<num_diagnostics(ctx); ++i)
+	{
+		const struct Diagnostic *diag = get_diagnostic(ctx, i);
+
+		char mem[128];
+		struct StrBuf msg;
+		strbuf_init(&msg, mem, sizeof(mem));
+
+		if(diag->pos >= 0)
+		{
+			strbuf_append(&msg, "Error at column ");
+			strbuf_append_int(&msg, diag->pos + 1, 10);
+			strbuf_append(&msg, ": ");
+		}
+		else
+		{
+			strbuf_append(&msg, "Error: ");
+		}
+		strbuf_append(&msg, error_message(diag->code));
+
+		if(diag->text[0])
+		{
+			strbuf_append(&msg, ": \"");
+			strbuf_append(&msg, diag->text);
+			strbuf_append_char(&msg, '"');
+		}
+		strbuf_append(&msg, ".\n");
+
+		print_message(ctx, msg.str, msg.len);
+	}
+
+	clear_diagnostics(ctx);
+}
+
+
+const char* error_message(int code)
+{
+	switch(code)
+	{
+		case EXPR_OK: return "No error";
+		case EXPR_ERR_INVALID_CHAR: return "Invalid character";
+		case EXPR_ERR_UNEXPECTED: return "Unexpected token";
+		case EXPR_ERR_INCOMPLETE: return "Incomplete expression";
+		case EXPR_ERR_UNMATCHED: return "Missing closing parenthesis";
+		case EXPR_ERR_NESTING: return "Expression is nested too deeply";
+		case EXPR_ERR_TOO_MANY_ARGS: return "Too many function arguments";
+		case EXPR_ERR_UNKNOWN_FUNC: return "Unknown function";
+		case EXPR_ERR_CONST_ASSIGN: return "Cannot assign to constant";
+		case EXPR_ERR_UNKNOWN_IDENT: return "Unknown identifier";
+		case EXPR_ERR_BATCH_ASSIGN: return "Assignments are not supported in batch evaluation";
+		case EXPR_ERR_BATCH_BRANCH: return "Conditionals are not supported in batch evaluation";
+		case EXPR_ERR_RECURSION: return "Function calls are nested too deeply";
+		case EXPR_ERR_MEMORY: return "Out of memory";
+		case EXPR_ERR_INTERNAL: return "Internal error";
+	}
+
+	return "Unknown error";
+}
@@ -0,0 +1,74 @@
+/**
+ * error codes and diagnostics of the expression parser
+ *
+ * @author agent
+ * @date 16-oct-2026
+ * @license GPLv3, see 'LICENSE' file
+ */
+
+#ifndef __EXPR_DIAG_H__
+#define __EXPR_DIAG_H__
+
+#include "string.h"
+
+
+#define EXPR_MAX_DIAGS     8    // number of diagnostics kept per context
+#define EXPR_DIAG_TEXT_LEN 16   // length of the offending text kept in a diagnostic
+
+
+enum ExprError
+{
+	EXPR_OK = 0,
+
+	// lexer and parser
+	EXPR_ERR_INVALID_CHAR,      // character which doesn't start a token
+	EXPR_ERR_UNEXPECTED,        // token not allowed at this position
+	EXPR_ERR_INCOMPLETE,        // input ends within an expression
+	EXPR_ERR_UNMATCHED,         // missing ')'
+	EXPR_ERR_NESTING,           // parser or program stack capacity exceeded
+	EXPR_ERR_TOO_MANY_ARGS,
+	EXPR_ERR_UNKNOWN_FUNC,
+	EXPR_ERR_CONST_ASSIGN,
+
+	// evaluation
+	EXPR_ERR_UNKNOWN_IDENT,
+	EXPR_ERR_BATCH_ASSIGN,      // assignment in a batch evaluation
+	EXPR_ERR_BATCH_BRANCH,      // conditional in a batch evaluation
+	EXPR_ERR_RECURSION,         // user-defined function calls nested too deeply
+
+	EXPR_ERR_MEMORY,
+	EXPR_ERR_INTERNAL,
+};
+
+
+struct Diagnostic
+{
+	int code;
+	int pos, len;               // span in the input, pos < 0: no position
+	char text[EXPR_DIAG_TEXT_LEN];  // offending token or name, possibly truncated
+};
+
+
+/**
+ * the most recent diagnostics, older ones are overwritten
+ */
+struct DiagRing
+{
+	struct Diagnostic entries[EXPR_MAX_DIAGS];
+	u32 count;                  // total number of reported diagnostics
+	u32 first;                  // number of the oldest one not yet cleared
+};
+
+
+struct ParserContext;
+
+extern void report_error(struct ParserContext* ctx, int code, int pos, int len,
+	const char* text, int text_len);
+extern u32 num_diagnostics(const struct ParserContext* ctx);
+extern const struct Diagnostic* get_diagnostic(const struct ParserContext* ctx, u32 idx);
+extern void clear_diagnostics(struct ParserContext* ctx);
+extern void print_diagnostics(struct ParserContext* ctx);
+extern const char* error_message(int code);
+
+
+#endif
@@ -0,0 +1,322 @@
+/**
+ * read-only environment of constants and functions shared by parser contexts
+ *
+ * the published snapshot is never modified: a writer copies it, changes the
+ * copy and publishes it by swapping a pointer, while readers keep using
+ * their snapshot until they pick up the new one, without any locking;
+ * contexts see the shared environment below their own registered functions,
+ * which act as a per-context overlay
+ *
+ * @author agent
+ * @date 16-oct-2026
+ * @license GPLv3, see 'LICENSE' file
+ *
+ * References:
+ *	- https://en.wikipedia.org/wiki/Read-copy-update
+ *	- "C++ Concurrency in Action", ISBN: 978-1617294693 (2019), ch. 7.2.4, split reference counts
+ */
+
+#include "expr_env.h"
+#include "expr_code.h"
+
+
+#define ENV_PTR_MASK ((1ul << ENV_PTR_BITS) - 1)
+#define ENV_REF_INC  (1ul << ENV_PTR_BITS)
+
+
+// ----------------------------------------------------------------------------
+// snapshots
+// ----------------------------------------------------------------------------
+
+static int grow_consts(struct ExprEnv* env)
+{
+	u32 new_cap = env->consts_cap ? env->consts_cap*2 : 16;
+	struct EnvConst *consts = (struct EnvConst*)expr_calloc(env->alloc,
+		new_cap, sizeof(struct EnvConst));
+	if(!consts)
+		return 0;
+
+	for(u32 i=0; i<env->consts_cap; ++i)
+	{
+		const struct EnvConst *entry = env->consts + i;
+		if(!entry->name)
+			continue;
+
+		u32 pos = entry->hash & (new_cap-1);
+		while(consts[pos].name)
+			pos = (pos+1) & (new_cap-1);
+		consts[pos] = *entry;
+	}
+
+	expr_free(env->alloc, env->consts);
+	env->consts = consts;
+	env->consts_cap = new_cap;
+	return 1;
+}
+
+
+/**
+ * find the slot for a name, which is either its constant's slot or a free one
+ */
+static struct EnvConst* lookup_const(const struct ExprEnv* env, const char* name, u32 len, u32 hash)
+{
+	if(!env->consts_cap)
+		return 0;
+
+	u32 mask = env->consts_cap - 1;
+	for(u32 pos = hash & mask; ; pos = (pos+1) & mask)
+	{
+		struct EnvConst *entry = env->consts + pos;
+		if(!entry->name)
+			return entry;
+		if(entry->hash == hash && entry->name_len == len
+			&& my_strncmp(entry->name, name, len) == 0)
+			return entry;
+	}
+}
+
+
+/**
+ * add or replace a constant, only allowed before the snapshot is published
+ */
+int env_set_const(struct ExprEnv* env, const char* name, t_value val)
+{
+	u32 len = my_strlen(name);
+	u32 hash = (u32)my_strnhash(name, len);
+
+	// keep the load factor below 3/4
+	if((env->num_consts+1)*4 > env->consts_cap*3 && !grow_consts(env))
+		return 0;
+
+	struct EnvConst *entry = lookup_const(env, name, len, hash);
+	if(!entry->name)
+	{
+		entry->name = (char*)expr_alloc(env->alloc, len + 1);
+		if(!entry->name)
+			return 0;
+
+		my_strncpy(entry->name, name, len + 1);
+		entry->name_len = len;
+		entry->hash = hash;
+		++env->num_consts;
+	}
+
+	entry->val = val;
+	return 1;
+}
+
+
+/**
+ * add or replace a function, only allowed before the snapshot is published
+ * @param arity number of arguments or FUNC_VARARGS
+ */
+int env_register_func(struct ExprEnv* env, const char* name, int arity, union Func func)
+{
+	if(arity < 0 || arity >= FUNC_ARITIES)
+		return 0;
+
+	return insert_func(env->alloc, env->funcs + arity, name, func);
+}
+
+
+int find_env_const(const struct ExprEnv* env, const char* name, int len, t_value* val)
+{
+	if(!env->num_consts)
+		return 0;
+
+	const struct EnvConst *entry = lookup_const(env, name, len, (u32)my_strnhash(name, len));
+	if(!entry || !entry->name)
+		return 0;
+
+	*val = entry->val;
+	return 1;
+}
+
+
+/**
+ * create an empty snapshot or a modifiable copy of the given one
+ */
+struct ExprEnv* create_env(const struct ExprAllocator* alloc, const struct ExprEnv* base)
+{
+	struct ExprEnv *env = (struct ExprEnv*)expr_alloc(alloc, sizeof(struct ExprEnv));
+	if(!env)
+		return 0;
+
+	env->consts = 0;
+	env->num_consts = env->consts_cap = 0;
+	for(int arity=0; arity<FUNC_ARITIES; ++arity)
+	{
+		env->funcs[arity].entries = 0;
+		env->funcs[arity].num = env->funcs[arity].cap = 0;
+	}
+
+	atomic_init(&env->refs, 0);
+	env->alloc = alloc;
+
+	if(!base)
+		return env;
+
+	for(u32 i=0; i<base->consts_cap; ++i)
+	{
+		const struct EnvConst *entry = base->consts + i;
+		if(entry->name && !env_set_const(env, entry->name, entry->val))
+		{
+			free_env(env);
+			return 0;
+		}
+	}
+
+	for(int arity=0; arity<FUNC_ARITIES; ++arity)
+	{
+		const struct FuncTable *tab = base->funcs + arity;
+		for(u32 i=0; i<tab->cap; ++i)
+		{
+			const struct FuncEntry *entry = tab->entries + i;
+			if(entry->name && !insert_func(alloc, env->funcs + arity, entry->name, entry->func))
+			{
+				free_env(env);
+				return 0;
+			}
+		}
+	}
+
+	return env;
+}
+
+
+/**
+ * free a snapshot which has not been published
+ */
+void free_env(struct ExprEnv* env)
+{
+	if(!env)
+		return;
+
+	for(u32 i=0; i<env->consts_cap; ++i)
+		expr_free(env->alloc, env->consts[i].name);
+	expr_free(env->alloc, env->consts);
+
+	for(int arity=0; arity<FUNC_ARITIES; ++arity)
+		free_func_table(env->alloc, env->funcs + arity);
+
+	expr_free(env->alloc, env);
+}
+// ----------------------------------------------------------------------------
+
+
+
+// ----------------------------------------------------------------------------
+// publishing
+// a snapshot's references are counted in two places: taking one increments
+// the count next to the pointer in SharedEnv::cur, so that the snapshot itself
+// is not touched before it is safe to do so, while releasing one decrements
+// ExprEnv::refs; once the snapshot has been replaced, the taken references are
+// added to ExprEnv::refs and the last reader to release it frees it
+// ----------------------------------------------------------------------------
+
+void init_shared_env(struct SharedEnv* shared, const struct ExprAllocator* alloc)
+{
+	shared->alloc = alloc;
+	atomic_init(&shared->cur, (u64)create_env(alloc, 0));
+}
+
+
+/**
+ * the contexts using the environment may still keep their snapshot
+ */
+void deinit_shared_env(struct SharedEnv* shared)
+{
+	publish_env(shared, 0);
+}
+
+
+/**
+ * get a modifiable copy of the current snapshot,
+ * the environment should only have one writer at a time
+ */
+struct ExprEnv* copy_shared_env(struct SharedEnv* shared)
+{
+	// only the writer replaces the snapshot, so it stays valid here
+	u64 cur = atomic_load_explicit(&shared->cur, memory_order_acquire);
+	return create_env(shared->alloc, (const struct ExprEnv*)(cur & ENV_PTR_MASK));
+}
+
+
+/**
+ * replace the current snapshot, which is freed once the last reader releases it
+ */
+void publish_env(struct SharedEnv* shared, struct ExprEnv* env)
+{
+	u64 old = atomic_exchange_explicit(&shared->cur, (u64)env, memory_order_acq_rel);
+
+	struct ExprEnv *old_env = (struct ExprEnv*)(old & ENV_PTR_MASK);
+	i64 taken = (i64)(old >> ENV_PTR_BITS);
+	if(!old_env)
+		return;
+
+	if(atomic_fetch_add_explicit(&old_env->refs, taken, memory_order_acq_rel) + taken == 0)
+		free_env(old_env);
+}
+
+
+/**
+ * take a reference to the current snapshot, without blocking
+ */
+struct ExprEnv* acquire_env(struct SharedEnv* shared)
+{
+	u64 cur = atomic_fetch_add_explicit(&shared->cur, ENV_REF_INC, memory_order_acq_rel);
+	return (struct ExprEnv*)(cur & ENV_PTR_MASK);
+}
+
+
+void release_env(struct ExprEnv* env)
+{
+	if(!env)
+		return;
+
+	// the count only becomes positive after the snapshot has been replaced
+	if(atomic_fetch_sub_explicit(&env->refs, 1, memory_order_acq_rel) == 1)
+		free_env(env);
+}
+// ----------------------------------------------------------------------------
+
+
+
+// ----------------------------------------------------------------------------
+// parser contexts
+// ----------------------------------------------------------------------------
+
+/**
+ * use a shared environment below the context's own functions, 0: none
+ */
+void attach_env(struct ParserContext* ctx, struct SharedEnv* shared)
+{
+	release_env(ctx->env);
+	ctx->env = 0;
+	ctx->shared_env = shared;
+
+	refresh_env(ctx);
+	invalidate_programs(ctx);
+}
+
+
+/**
+ * switch to the most recently published snapshot
+ */
+void refresh_env(struct ParserContext* ctx)
+{
+	struct SharedEnv *shared = ctx->shared_env;
+	if(!shared)
+		return;
+
+	u64 cur = atomic_load_explicit(&shared->cur, memory_order_relaxed);
+	if((cur & ENV_PTR_MASK) == (u64)ctx->env)
+		return;
+
+	release_env(ctx->env);
+	ctx->env = acquire_env(shared);
+
+	// constants are substituted and functions resolved when compiling
+	invalidate_programs(ctx);
+}
+// ----------------------------------------------------------------------------
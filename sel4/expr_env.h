@@ -0,0 +1,76 @@
+/**
+ * read-only environment of constants and functions shared by parser contexts
+ *
+ * @author agent
+ * @date 16-oct-2026
+ * @license GPLv3, see 'LICENSE' file
+ */
+
+#ifndef __EXPR_ENV_H__
+#define __EXPR_ENV_H__
+
+#include <stdatomic.h>
+
+#include "string.h"
+#include "expr_parser.h"
+#include "expr_funcs.h"
+
+
+#define ENV_PTR_BITS 48     // significant bits of a snapshot's address, the other 16 count
+                            // the references taken to it, at most 65535 per snapshot
+
+
+struct EnvConst
+{
+	char *name;             // 0: free slot
+	u32 name_len;
+	u32 hash;
+	t_value val;
+};
+
+
+/**
+ * snapshot of the environment, immutable once it is published
+ */
+struct ExprEnv
+{
+	struct EnvConst *consts;        // open-addressing hash table, power-of-two size
+	u32 num_consts, consts_cap;
+
+	struct FuncTable funcs[FUNC_ARITIES];
+
+	_Atomic i64 refs;               // released references, see publish_env()
+	const struct ExprAllocator *alloc;
+};
+
+
+/**
+ * currently published snapshot
+ */
+struct SharedEnv
+{
+	// address of the snapshot, the upper bits count the references taken to it
+	_Atomic u64 cur;
+
+	const struct ExprAllocator *alloc;  // used by all threads, has to be thread-safe
+};
+
+
+extern struct ExprEnv* create_env(const struct ExprAllocator* alloc, const struct ExprEnv* base);
+extern void free_env(struct ExprEnv* env);
+extern int env_set_const(struct ExprEnv* env, const char* name, t_value val);
+extern int env_register_func(struct ExprEnv* env, const char* name, int arity, union Func func);
+extern int find_env_const(const struct ExprEnv* env, const char* name, int len, t_value* val);
+
+extern void init_shared_env(struct SharedEnv* shared, const struct ExprAllocator* alloc);
+extern void deinit_shared_env(struct SharedEnv* shared);
+extern struct ExprEnv* copy_shared_env(struct SharedEnv* shared);
+extern void publish_env(struct SharedEnv* shared, struct ExprEnv* env);
+extern struct ExprEnv* acquire_env(struct SharedEnv* shared);
+extern void release_env(struct ExprEnv* env);
+
+extern void attach_env(struct ParserContext* ctx, struct SharedEnv* shared);
+extern void refresh_env(struct ParserContext* ctx);
+
+
+#endif
@@ -0,0 +1,545 @@
+/**
+ * built-in and registered functions for the expression parser
+ *
+ * @author agent
+ * @date 16-oct-2026
+ * @license GPLv3, see 'LICENSE' file
+ *
+ * References:
+ *	- https://www.gnu.org/software/gperf/manual/gperf.html
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+
+#include "expr_funcs.h"
+#include "expr_code.h"
+#include "expr_env.h"
+
+
+// ----------------------------------------------------------------------------
+// built-in functions
+// ----------------------------------------------------------------------------
+#define DEF_FUNC1(name) static t_value func_##name(t_value x) { return (t_value)name(x); }
+#define DEF_FUNC2(name) static t_value func_##name(t_value x, t_value y) { return (t_value)name(x, y); }
+
+DEF_FUNC1(sqrt)
+DEF_FUNC1(sin)
+DEF_FUNC1(cos)
+DEF_FUNC1(tan)
+DEF_FUNC1(asin)
+DEF_FUNC1(acos)
+DEF_FUNC1(atan)
+DEF_FUNC1(log)
+DEF_FUNC1(log2)
+DEF_FUNC1(log10)
+
+DEF_FUNC2(atan2)
+DEF_FUNC2(pow)
+
+
+struct BuiltinFunc
+{
+	const char *name;
+	int num_args;
+	union Func func;
+};
+
+
+/**
+ * perfect hash of the built-in function names,
+ * using the second and the last character of the name
+ */
+#define BUILTIN_SLOT(second, last) (((second) + 3*(last)) & (FUNC_BUILTIN_SLOTS-1))
+
+
+static u32 builtin_slot(const char* name, int len)
+{
+	char second = len > 1 ? name[1] : name[0];
+	return BUILTIN_SLOT((u8)second, (u8)name[len-1]);
+}
+
+
+// the slots are computed at compile time, none of them collide
+static const struct BuiltinFunc builtin_funcs[FUNC_BUILTIN_SLOTS] =
+{
+	[BUILTIN_SLOT('q', 't')] = { "sqrt",  1, { .f1 = &func_sqrt } },
+	[BUILTIN_SLOT('i', 'n')] = { "sin",   1, { .f1 = &func_sin } },
+	[BUILTIN_SLOT('o', 's')] = { "cos",   1, { .f1 = &func_cos } },
+	[BUILTIN_SLOT('a', 'n')] = { "tan",   1, { .f1 = &func_tan } },
+	[BUILTIN_SLOT('s', 'n')] = { "asin",  1, { .f1 = &func_asin } },
+	[BUILTIN_SLOT('c', 's')] = { "acos",  1, { .f1 = &func_acos } },
+	[BUILTIN_SLOT('t', 'n')] = { "atan",  1, { .f1 = &func_atan } },
+	[BUILTIN_SLOT('o', 'g')] = { "log",   1, { .f1 = &func_log } },
+	[BUILTIN_SLOT('o', '2')] = { "log2",  1, { .f1 = &func_log2 } },
+	[BUILTIN_SLOT('o', '0')] = { "log10", 1, { .f1 = &func_log10 } },
+
+	[BUILTIN_SLOT('t', '2')] = { "atan2", 2, { .f2 = &func_atan2 } },
+	[BUILTIN_SLOT('o', 'w')] = { "pow",   2, { .f2 = &func_pow } },
+};
+
+
+static const struct BuiltinFunc* find_builtin(const char* name, int len)
+{
+	if(len <= 0)
+		return 0;
+
+	const struct BuiltinFunc *builtin = builtin_funcs + builtin_slot(name, len);
+	if(!builtin->name)
+		return 0;
+	if(my_strlen(builtin->name) != (u64)len || my_strncmp(builtin->name, name, len) != 0)
+		return 0;
+
+	return builtin;
+}
+
+
+/**
+ * built-in constants, these are substituted when compiling
+ */
+static const struct
+{
+	const char *name;
+	t_value val;
+} builtin_consts[] =
+{
+	{ "pi", M_PI },
+};
+
+
+/**
+ * find a constant of the shared environment or a built-in one
+ */
+int find_const(const struct ParserContext* ctx, const char* name, int len, t_value* val)
+{
+	if(ctx->env && find_env_const(ctx->env, name, len, val))
+		return 1;
+
+	for(u64 i=0; i<sizeof(builtin_consts)/sizeof(*builtin_consts); ++i)
+	{
+		if(my_strlen(builtin_consts[i].name) == (u64)len
+			&& my_strncmp(builtin_consts[i].name, name, len) == 0)
+		{
+			*val = builtin_consts[i].val;
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+
+t_func1 get_builtin_func1(const char* name)
+{
+	const struct BuiltinFunc *builtin = find_builtin(name, my_strlen(name));
+	if(!builtin || builtin->num_args != 1)
+		return 0;
+
+	return builtin->func.f1;
+}
+// ----------------------------------------------------------------------------
+
+
+
+// ----------------------------------------------------------------------------
+// registered functions
+// ----------------------------------------------------------------------------
+
+struct FuncRegistry* create_func_registry(const struct ExprAllocator* alloc)
+{
+	struct FuncRegistry *reg = (struct FuncRegistry*)expr_alloc(alloc, sizeof(struct FuncRegistry));
+	if(!reg)
+		return 0;
+
+	reg->alloc = alloc;
+
+	for(int arity=0; arity<FUNC_ARITIES; ++arity)
+	{
+		reg->tables[arity].entries = 0;
+		reg->tables[arity].num = reg->tables[arity].cap = 0;
+	}
+
+	return reg;
+}
+
+
+void free_func_registry(struct FuncRegistry* reg)
+{
+	if(!reg)
+		return;
+
+	for(int arity=0; arity<FUNC_ARITIES; ++arity)
+		free_func_table(reg->alloc, reg->tables + arity);
+
+	expr_free(reg->alloc, reg);
+}
+
+
+void free_func_table(const struct ExprAllocator* alloc, struct FuncTable* tab)
+{
+	for(u32 i=0; i<tab->cap; ++i)
+		expr_free(alloc, tab->entries[i].name);
+	expr_free(alloc, tab->entries);
+
+	tab->entries = 0;
+	tab->num = tab->cap = 0;
+}
+
+
+/**
+ * find the slot for a name, which is either its function's slot or a free one
+ */
+struct FuncEntry* lookup_func_entry(const struct FuncTable* tab,
+	const char* name, u32 len, u32 hash)
+{
+	if(!tab->cap)
+		return 0;
+
+	u32 mask = tab->cap - 1;
+	for(u32 pos = hash & mask; ; pos = (pos+1) & mask)
+	{
+		struct FuncEntry *entry = tab->entries + pos;
+		if(!entry->name)
+			return entry;
+		if(entry->hash == hash && entry->name_len == len
+			&& my_strncmp(entry->name, name, len) == 0)
+			return entry;
+	}
+}
+
+
+static int grow_table(const struct ExprAllocator* alloc, struct FuncTable* tab)
+{
+	u32 new_cap = tab->cap ? tab->cap*2 : 16;
+	struct FuncEntry *new_entries = (struct FuncEntry*)expr_calloc(alloc,
+		new_cap, sizeof(struct FuncEntry));
+	if(!new_entries)
+		return 0;
+
+	for(u32 i=0; i<tab->cap; ++i)
+	{
+		const struct FuncEntry *entry = tab->entries + i;
+		if(!entry->name)
+			continue;
+
+		u32 pos = entry->hash & (new_cap-1);
+		while(new_entries[pos].name)
+			pos = (pos+1) & (new_cap-1);
+		new_entries[pos] = *entry;
+	}
+
+	expr_free(alloc, tab->entries);
+	tab->entries = new_entries;
+	tab->cap = new_cap;
+	return 1;
+}
+
+
+/**
+ * add a function to a table or replace the function of the same name
+ */
+int insert_func(const struct ExprAllocator* alloc, struct FuncTable* tab,
+	const char* name, union Func func)
+{
+	u32 len = my_strlen(name);
+	u32 hash = (u32)my_strnhash(name, len);
+
+	// keep the load factor below 3/4
+	if((tab->num+1)*4 > tab->cap*3 && !grow_table(alloc, tab))
+		return 0;
+
+	struct FuncEntry *entry = lookup_func_entry(tab, name, len, hash);
+	if(!entry->name)
+	{
+		entry->name = (char*)expr_alloc(alloc, len + 1);
+		if(!entry->name)
+			return 0;
+
+		my_strncpy(entry->name, name, len + 1);
+		entry->name_len = len;
+		entry->hash = hash;
+		++tab->num;
+	}
+
+	entry->func = func;
+	return 1;
+}
+
+
+static int register_func(struct ParserContext* ctx, const char* name, int arity, union Func func)
+{
+	if(!ctx->funcs || !insert_func(ctx->funcs->alloc, ctx->funcs->tables + arity, name, func))
+		return 0;
+
+	// cached programs might refer to a previous function of this name
+	invalidate_programs(ctx);
+	return 1;
+}
+
+
+int register_func0(struct ParserContext* ctx, const char* name, t_func0 func)
+{
+	union Func f = { .f0 = func };
+	return register_func(ctx, name, 0, f);
+}
+
+
+int register_func1(struct ParserContext* ctx, const char* name, t_func1 func)
+{
+	union Func f = { .f1 = func };
+	return register_func(ctx, name, 1, f);
+}
+
+
+int register_func2(struct ParserContext* ctx, const char* name, t_func2 func)
+{
+	union Func f = { .f2 = func };
+	return register_func(ctx, name, 2, f);
+}
+
+
+/**
+ * register a function taking any number of arguments
+ */
+int register_funcn(struct ParserContext* ctx, const char* name, t_funcn func)
+{
+	union Func f = { .fn = func };
+	return register_func(ctx, name, FUNC_VARARGS, f);
+}
+// ----------------------------------------------------------------------------
+
+
+
+// ----------------------------------------------------------------------------
+// function lookup
+// ----------------------------------------------------------------------------
+
+/**
+ * find a function in the tables of the given arity and of n-ary functions
+ * @return arity index of the function or -1 if it was not found
+ */
+static int find_in_tables(const struct FuncTable* tables, const char* name, int len,
+	int num_args, union Func* func)
+{
+	if(!tables[0].num && !tables[1].num && !tables[2].num && !tables[FUNC_VARARGS].num)
+		return -1;
+
+	u32 hash = (u32)my_strnhash(name, len);
+
+	if(num_args < FUNC_VARARGS)
+	{
+		const struct FuncEntry *entry = lookup_func_entry(
+			tables + num_args, name, len, hash);
+		if(entry && entry->name)
+		{
+			*func = entry->func;
+			return num_args;
+		}
+	}
+
+	const struct FuncEntry *entry = lookup_func_entry(
+		tables + FUNC_VARARGS, name, len, hash);
+	if(entry && entry->name)
+	{
+		*func = entry->func;
+		return FUNC_VARARGS;
+	}
+
+	return -1;
+}
+
+
+/**
+ * find a function by name and number of arguments, the context's registered
+ * functions take precedence over the shared environment and the built-in ones
+ * @param pure is set if the function has no side effects
+ * @return arity index of the function or -1 if it was not found
+ */
+int find_func(const struct ParserContext* ctx, const char* name, int len,
+	int num_args, union Func* func, int* pure)
+{
+	// registered functions might not be pure
+	*pure = 0;
+
+	int arity = -1;
+	if(ctx->funcs)
+		arity = find_in_tables(ctx->funcs->tables, name, len, num_args, func);
+	if(arity < 0 && ctx->env)
+		arity = find_in_tables(ctx->env->funcs, name, len, num_args, func);
+	if(arity >= 0)
+		return arity;
+
+	const struct BuiltinFunc *builtin = find_builtin(name, len);
+	if(builtin && builtin->num_args == num_args)
+	{
+		*func = builtin->func;
+		*pure = 1;
+		return num_args;
+	}
+
+	return -1;
+}
+// ----------------------------------------------------------------------------
+
+
+
+// ----------------------------------------------------------------------------
+// user-defined functions
+// ----------------------------------------------------------------------------
+
+struct UserFunc* create_user_func(const struct ExprAllocator* alloc, const char* name, int len)
+{
+	struct UserFunc *func = (struct UserFunc*)expr_alloc(alloc, sizeof(struct UserFunc));
+	if(!func)
+		return 0;
+
+	func->name = (char*)expr_alloc(alloc, len + 1);
+	if(!func->name)
+	{
+		expr_free(alloc, func);
+		return 0;
+	}
+
+	my_strncpy(func->name, name, len);
+	func->name[len] = 0;
+	func->name_len = len;
+
+	func->prog = 0;
+	func->num_params = 0;
+	func->pure = 0;
+	func->calls_user = 0;
+
+	func->memo_hashes = 0;
+	func->memo_vals = 0;
+	func->memo_cap = 0;
+	func->alloc = alloc;
+
+	return func;
+}
+
+
+void free_user_func(struct UserFunc* func)
+{
+	if(!func)
+		return;
+
+	init_memo(func, 0);
+	free_program(func->prog);
+	expr_free(func->alloc, func->name);
+	expr_free(func->alloc, func);
+}
+
+
+/**
+ * set up the memoisation of the function's results
+ * @param cap number of results to keep, 0 disables memoisation
+ */
+int init_memo(struct UserFunc* func, u32 cap)
+{
+	expr_free(func->alloc, func->memo_hashes);
+	expr_free(func->alloc, func->memo_vals);
+	func->memo_hashes = 0;
+	func->memo_vals = 0;
+	func->memo_cap = 0;
+
+	if(!cap)
+		return 1;
+
+	u32 pow2 = 1;
+	while(pow2 < cap)
+		pow2 *= 2;
+
+	func->memo_hashes = (u64*)expr_calloc(func->alloc, pow2, sizeof(u64));
+	func->memo_vals = (t_value*)expr_alloc(func->alloc,
+		pow2 * (func->num_params + 1) * sizeof(t_value));
+	if(!func->memo_hashes || !func->memo_vals)
+	{
+		init_memo(func, 0);
+		return 0;
+	}
+
+	func->memo_cap = pow2;
+	return 1;
+}
+
+
+/**
+ * forget the memoised results, e.g. if a function called by this one has changed
+ */
+void clear_memo(struct UserFunc* func)
+{
+	if(func->memo_hashes)
+		my_memset((i8*)func->memo_hashes, 0, func->memo_cap * sizeof(u64));
+}
+
+
+/**
+ * hash the bit patterns of the arguments, never 0
+ */
+static u64 memo_hash(const t_value* args, int num_args)
+{
+	u64 hash = 0xcbf29ce484222325;
+	const u8 *bytes = (const u8*)args;
+	for(u64 i=0; i<num_args*sizeof(t_value); ++i)
+		hash = (hash ^ bytes[i]) * 0x100000001b3;
+
+	return hash | 1;
+}
+
+
+static int args_equal(const t_value* args1, const t_value* args2, int num_args)
+{
+	const u8 *bytes1 = (const u8*)args1;
+	const u8 *bytes2 = (const u8*)args2;
+	for(u64 i=0; i<num_args*sizeof(t_value); ++i)
+	{
+		if(bytes1[i] != bytes2[i])
+			return 0;
+	}
+
+	return 1;
+}
+
+
+/**
+ * @return 1 if a result for the arguments is known
+ */
+int memo_lookup(const struct UserFunc* func, const t_value* args, t_value* result)
+{
+	if(!func->memo_cap)
+		return 0;
+
+	u64 hash = memo_hash(args, func->num_params);
+	u32 idx = hash & (func->memo_cap - 1);
+	if(func->memo_hashes[idx] != hash)
+		return 0;
+
+	const t_value *entry = func->memo_vals + idx*(func->num_params + 1);
+	if(!args_equal(entry + 1, args, func->num_params))
+		return 0;
+
+	*result = entry[0];
+	return 1;
+}
+
+
+/**
+ * remember a result, replacing the entry of other arguments with the same index
+ */
+void memo_store(struct UserFunc* func, const t_value* args, t_value result)
+{
+	if(!func->memo_cap)
+		return;
+
+	u64 hash = memo_hash(args, func->num_params);
+	u32 idx = hash & (func->memo_cap - 1);
+
+	t_value *entry = func->memo_vals + idx*(func->num_params + 1);
+	entry[0] = result;
+	for(int i=0; i<func->num_params; ++i)
+		entry[i + 1] = args[i];
+
+	func->memo_hashes[idx] = hash;
+}
+// ----------------------------------------------------------------------------
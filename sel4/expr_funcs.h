@@ -0,0 +1,116 @@
+/**
+ * built-in and registered functions for the expression parser
+ *
+ * @author agent
+ * @date 16-oct-2026
+ * @license GPLv3, see 'LICENSE' file
+ */
+
+#ifndef __EXPR_FUNCS_H__
+#define __EXPR_FUNCS_H__
+
+#include "string.h"
+#include "expr_parser.h"
+
+
+#define FUNC_VARARGS       3    // arity index of n-ary functions
+#define FUNC_ARITIES       4    // 0, 1, 2 and n arguments
+#define FUNC_BUILTIN_SLOTS 32   // size of the perfect hash table of built-in functions
+#define FUNC_MAX_PARAMS    8    // maximum number of parameters of user-defined functions
+#define FUNC_MEMO_SIZE     64   // default number of memoised results per pure function
+
+
+typedef t_value (*t_func0)(void);
+typedef t_value (*t_func1)(t_value);
+typedef t_value (*t_func2)(t_value, t_value);
+typedef t_value (*t_funcn)(const t_value* args, int num_args);
+
+
+union Func
+{
+	t_func0 f0;
+	t_func1 f1;
+	t_func2 f2;
+	t_funcn fn;
+};
+
+
+struct FuncEntry
+{
+	char *name;     // 0: free slot
+	u32 name_len;
+	u32 hash;
+	union Func func;
+};
+
+
+/**
+ * open-addressing hash table of functions having the same arity
+ */
+struct FuncTable
+{
+	struct FuncEntry *entries;
+	u32 num, cap;
+};
+
+
+/**
+ * functions registered by the embedder, indexed by arity
+ */
+struct FuncRegistry
+{
+	struct FuncTable tables[FUNC_ARITIES];
+	const struct ExprAllocator *alloc;
+};
+
+
+/**
+ * function defined in an expression, e.g. f(x, y) = x^2 + y
+ */
+struct UserFunc
+{
+	char *name;
+	u32 name_len;
+
+	struct ExprProgram *prog;   // compiled body, reading its arguments with OP_ARG
+	int num_params;
+	int pure;                   // the result only depends on the arguments
+	int calls_user;             // the body calls other user-defined functions
+
+	// results of pure functions, direct-mapped by the hash of the arguments
+	u64 *memo_hashes;           // 0: free entry
+	t_value *memo_vals;         // per entry: result followed by the arguments
+	u32 memo_cap;               // power of two, 0: no memoisation
+
+	const struct ExprAllocator *alloc;
+};
+
+
+extern struct FuncRegistry* create_func_registry(const struct ExprAllocator* alloc);
+extern void free_func_registry(struct FuncRegistry* reg);
+
+extern int register_func0(struct ParserContext* ctx, const char* name, t_func0 func);
+extern int register_func1(struct ParserContext* ctx, const char* name, t_func1 func);
+extern int register_func2(struct ParserContext* ctx, const char* name, t_func2 func);
+extern int register_funcn(struct ParserContext* ctx, const char* name, t_funcn func);
+
+extern int insert_func(const struct ExprAllocator* alloc, struct FuncTable* tab,
+	const char* name, union Func func);
+extern struct FuncEntry* lookup_func_entry(const struct FuncTable* tab,
+	const char* name, u32 len, u32 hash);
+extern void free_func_table(const struct ExprAllocator* alloc, struct FuncTable* tab);
+
+extern t_func1 get_builtin_func1(const char* name);
+extern int find_func(const struct ParserContext* ctx, const char* name, int len,
+	int num_args, union Func* func, int* pure);
+extern int find_const(const struct ParserContext* ctx, const char* name, int len, t_value* val);
+
+extern struct UserFunc* create_user_func(const struct ExprAllocator* alloc, const char* name, int len);
+extern void free_user_func(struct UserFunc* func);
+extern int init_memo(struct UserFunc* func, u32 cap);
+extern void clear_memo(struct UserFunc* func);
+extern int memo_lookup(const struct UserFunc* func, const t_value* args, t_value* result);
+extern void memo_store(struct UserFunc* func, const t_value* args, t_value result);
+
+
+#endif
@@ -0,0 +1,548 @@
+/**
+ * compiles expression bytecode to native x86-64 code
+ *
+ * the bytecode stack is kept in the native stack frame, with its top in xmm0;
+ * variable accesses, fmod, pow and function calls go through the system v calling convention;
+ * like the interpreter, the code returns at the first failing variable access
+ *
+ * @author agent
+ * @date 16-oct-2026
+ * @license GPLv3, see 'LICENSE' file
+ *
+ * References:
+ *	- https://www.felixcloutier.com/x86/
+ *	- https://gitlab.com/x86-psABIs/x86-64-ABI
+ */
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <math.h>
+
+#if defined(__linux__) && !__has_include(<sel4/sel4.h>)
+	#include <sys/mman.h>
+	#define JIT_USE_MMAP
+#endif
+
+#include "expr_jit.h"
+
+
+#if defined(__x86_64__) && !defined(USE_INTEGER)
+	#define JIT_SUPPORTED
+#endif
+
+
+// ----------------------------------------------------------------------------
+// executable memory
+// ----------------------------------------------------------------------------
+
+struct JitBlock
+{
+	u64 size;       // size of the block including this header
+	u64 used;
+};
+
+
+/**
+ * use the given executable memory or map some if none is given
+ * @return 1 on success
+ */
+int init_jit(struct ParserContext* ctx, void* mem, u64 size)
+{
+#ifndef JIT_SUPPORTED
+	(void)ctx; (void)mem; (void)size;
+	return 0;
+#else
+	if(ctx->jit)
+		return 1;
+
+	struct JitBuffer *jit = (struct JitBuffer*)expr_alloc(&ctx->alloc,
+		sizeof(struct JitBuffer));
+	if(!jit)
+		return 0;
+
+	jit->mapped = 0;
+	if(!mem)
+	{
+#ifdef JIT_USE_MMAP
+		size = JIT_DEFAULT_SIZE;
+		mem = mmap(0, size, PROT_READ | PROT_WRITE | PROT_EXEC,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if(mem == MAP_FAILED)
+			mem = 0;
+		jit->mapped = 1;
+#endif
+	}
+
+	if(!mem || size < 2*sizeof(struct JitBlock))
+	{
+		report_error(ctx, EXPR_ERR_MEMORY, -1, 0, 0, 0);
+		expr_free(&ctx->alloc, jit);
+		return 0;
+	}
+
+	jit->mem = (u8*)mem;
+	jit->size = size & ~(u64)(sizeof(struct JitBlock)-1);
+
+	// one free block covering the whole memory
+	struct JitBlock *block = (struct JitBlock*)jit->mem;
+	block->size = jit->size;
+	block->used = 0;
+
+	ctx->jit = jit;
+
+	// cached programs and formulas are compiled on their next use
+	invalidate_programs(ctx);
+	return 1;
+#endif
+}
+
+
+void deinit_jit(struct ParserContext* ctx)
+{
+	struct JitBuffer *jit = ctx->jit;
+	if(!jit)
+		return;
+
+#ifdef JIT_USE_MMAP
+	if(jit->mapped)
+		munmap(jit->mem, jit->size);
+#endif
+
+	expr_free(&ctx->alloc, jit);
+	ctx->jit = 0;
+}
+
+
+#ifdef JIT_SUPPORTED
+/**
+ * first-fit allocation of a block of executable memory
+ */
+static u8* jit_alloc(struct JitBuffer* jit, u64 size)
+{
+	// keep the blocks aligned to their header size
+	size = (size + sizeof(struct JitBlock) + sizeof(struct JitBlock)-1)
+		& ~(u64)(sizeof(struct JitBlock)-1);
+
+	for(u64 offs=0; offs<jit->size; )
+	{
+		struct JitBlock *block = (struct JitBlock*)(jit->mem + offs);
+		if(!block->used && block->size >= size)
+		{
+			// split the block if the rest is large enough to be useful
+			if(block->size - size >= 4*sizeof(struct JitBlock))
+			{
+				struct JitBlock *rest = (struct JitBlock*)(jit->mem + offs + size);
+				rest->size = block->size - size;
+				rest->used = 0;
+				block->size = size;
+			}
+
+			block->used = 1;
+			return (u8*)(block + 1);
+		}
+
+		offs += block->size;
+	}
+
+	return 0;
+}
+#endif
+
+
+void jit_free(struct JitBuffer* jit, void* code)
+{
+	if(!jit || !code)
+		return;
+
+	struct JitBlock *block = (struct JitBlock*)code - 1;
+	block->used = 0;
+
+	// merge adjacent free blocks
+	for(u64 offs=0; offs<jit->size; )
+	{
+		struct JitBlock *cur = (struct JitBlock*)(jit->mem + offs);
+		while(!cur->used && offs + cur->size < jit->size)
+		{
+			struct JitBlock *next = (struct JitBlock*)(jit->mem + offs + cur->size);
+			if(next->used)
+				break;
+			cur->size += next->size;
+		}
+
+		offs += cur->size;
+	}
+}
+// ----------------------------------------------------------------------------
+
+
+
+#ifdef JIT_SUPPORTED
+// ----------------------------------------------------------------------------
+// helpers called from the generated code
+// ----------------------------------------------------------------------------
+
+static t_value jit_load(struct ParserContext* ctx, const char* name)
+{
+	const struct Symbol *sym = find_symbol(ctx, name);
+	if(!sym)
+	{
+		report_error(ctx, EXPR_ERR_UNKNOWN_IDENT, -1, 0, name, my_strlen(name));
+		return 0;
+	}
+
+	return sym->value;
+}
+
+
+static t_value jit_store(struct ParserContext* ctx, const char* name, t_value val)
+{
+	assign_or_insert_symbol(ctx, name, val);
+	return val;
+}
+// ----------------------------------------------------------------------------
+
+
+
+// ----------------------------------------------------------------------------
+// instruction encoding
+// ----------------------------------------------------------------------------
+
+#define JIT_MAX_INSTR_SIZE 64       // upper bound of native bytes per bytecode instruction
+#define JIT_FRAME_SIZE     32       // upper bound of prologue and epilogue
+
+
+struct JitEmitter
+{
+	u8 *code;
+	u64 pos;
+};
+
+
+static void emit_bytes(struct JitEmitter* em, const u8* bytes, int len)
+{
+	for(int i=0; i<len; ++i)
+		em->code[em->pos++] = bytes[i];
+}
+
+
+static void emit_u32(struct JitEmitter* em, u32 val)
+{
+	for(int i=0; i<4; ++i)
+		em->code[em->pos++] = (u8)(val >> (i*8));
+}
+
+
+static void emit_u64(struct JitEmitter* em, u64 val)
+{
+	for(int i=0; i<8; ++i)
+		em->code[em->pos++] = (u8)(val >> (i*8));
+}
+
+
+/**
+ * movsd xmm0 or xmm1, [rsp + offs]
+ */
+static void emit_load_slot(struct JitEmitter* em, int xmm, u32 offs)
+{
+	const u8 op[] = { 0xf2, 0x0f, 0x10, (u8)(0x84 | (xmm << 3)), 0x24 };
+	emit_bytes(em, op, sizeof(op));
+	emit_u32(em, offs);
+}
+
+
+/**
+ * movsd [rsp + offs], xmm0
+ */
+static void emit_store_slot(struct JitEmitter* em, u32 offs)
+{
+	const u8 op[] = { 0xf2, 0x0f, 0x11, 0x84, 0x24 };
+	emit_bytes(em, op, sizeof(op));
+	emit_u32(em, offs);
+}
+
+
+/**
+ * mov rax, imm64
+ */
+static void emit_mov_rax(struct JitEmitter* em, u64 val)
+{
+	const u8 op[] = { 0x48, 0xb8 };
+	emit_bytes(em, op, sizeof(op));
+	emit_u64(em, val);
+}
+
+
+/**
+ * mov rsi, imm64
+ */
+static void emit_mov_rsi(struct JitEmitter* em, u64 val)
+{
+	const u8 op[] = { 0x48, 0xbe };
+	emit_bytes(em, op, sizeof(op));
+	emit_u64(em, val);
+}
+
+
+/**
+ * movq xmm0 or xmm1, rax
+ */
+static void emit_movq_xmm_rax(struct JitEmitter* em, int xmm)
+{
+	const u8 op[] = { 0x66, 0x48, 0x0f, 0x6e, (u8)(0xc0 | (xmm << 3)) };
+	emit_bytes(em, op, sizeof(op));
+}
+
+
+/**
+ * movsd xmm1, xmm0
+ */
+static void emit_xmm0_to_xmm1(struct JitEmitter* em)
+{
+	const u8 op[] = { 0xf2, 0x0f, 0x10, 0xc8 };
+	emit_bytes(em, op, sizeof(op));
+}
+
+
+/**
+ * mov rax, func; call rax
+ */
+static void emit_call_abs(struct JitEmitter* em, const void* func)
+{
+	const u8 op[] = { 0xff, 0xd0 };
+	emit_mov_rax(em, (u64)func);
+	emit_bytes(em, op, sizeof(op));
+}
+
+
+/**
+ * mov rdi, rbx; the context pointer is kept in rbx
+ */
+static void emit_ctx_arg(struct JitEmitter* em)
+{
+	const u8 op[] = { 0x48, 0x89, 0xdf };
+	emit_bytes(em, op, sizeof(op));
+}
+
+
+/**
+ * mov eax, [rbx + offs]; reads the context's number of diagnostics
+ */
+static void emit_load_diags(struct JitEmitter* em)
+{
+	const u8 op[] = { 0x8b, 0x83 };
+	emit_bytes(em, op, sizeof(op));
+	emit_u32(em, (u32)offsetof(struct ParserContext, diags.count));
+}
+
+
+/**
+ * add rsp, frame_size; pop rbx; ret
+ */
+static void emit_epilogue(struct JitEmitter* em, u32 frame_size)
+{
+	const u8 op_add[] = { 0x48, 0x81, 0xc4 };
+	const u8 op_ret[] = { 0x5b, 0xc3 };
+	emit_bytes(em, op_add, sizeof(op_add));
+	emit_u32(em, frame_size);
+	emit_bytes(em, op_ret, sizeof(op_ret));
+}
+// ----------------------------------------------------------------------------
+#endif
+
+
+
+// ----------------------------------------------------------------------------
+// compilation
+// ----------------------------------------------------------------------------
+
+/**
+ * compile the program to native code, which run_program() then uses
+ * @return 1 on success, 0 if the program has to be interpreted
+ */
+int jit_program(struct ParserContext* ctx, struct ExprProgram* prog)
+{
+#ifndef JIT_SUPPORTED
+	(void)ctx; (void)prog;
+	return 0;
+#else
+	if(!ctx->jit || !prog || prog->error || prog->jit_code)
+		return 0;
+
+	// check for unsupported instructions
+	for(int ip=0; ip<prog->code_len; ++ip)
+	{
+		int op = prog->code[ip].op;
+		if(op == OP_CALL0 || op == OP_CALLN || op == OP_ARG
+			|| op == OP_CALLU || op == OP_JZ || op == OP_JMP)
+			return 0;
+	}
+
+	u8 *code = jit_alloc(ctx->jit, prog->code_len*JIT_MAX_INSTR_SIZE + JIT_FRAME_SIZE);
+	if(!code)
+		return 0;
+
+	// frame: stack slots followed by the temporaries and the number of
+	// diagnostics at the start, 16-byte aligned
+	const u32 temps_offs = prog->max_stack * sizeof(t_value);
+	const u32 diags_offs = temps_offs + prog->num_temps*sizeof(t_value);
+	const u32 frame_size = (diags_offs + sizeof(u64) + 15) & ~15u;
+
+	struct JitEmitter em = { .code = code, .pos = 0 };
+
+	// prologue: push rbx; mov rbx, rdi; sub rsp, frame_size
+	{
+		const u8 op[] = { 0x53, 0x48, 0x89, 0xfb, 0x48, 0x81, 0xec };
+		emit_bytes(&em, op, sizeof(op));
+		emit_u32(&em, frame_size);
+	}
+
+	// mov [rsp + diags_offs], eax
+	{
+		const u8 op[] = { 0x89, 0x84, 0x24 };
+		emit_load_diags(&em);
+		emit_bytes(&em, op, sizeof(op));
+		emit_u32(&em, diags_offs);
+	}
+
+	int sp = 0;     // depth of the bytecode stack, its top is in xmm0
+	#define SLOT(idx) ((u32)((idx) * sizeof(t_value)))
+	#define SPILL() if(sp > 0) emit_store_slot(&em, SLOT(sp-1))
+
+	for(int ip=0; ip<prog->code_len; ++ip)
+	{
+		const struct ExprInstr *instr = prog->code + ip;
+
+		switch(instr->op)
+		{
+			case OP_END:
+			{
+				if(sp == 0)
+				{
+					// xorpd xmm0, xmm0
+					const u8 op[] = { 0x66, 0x0f, 0x57, 0xc0 };
+					emit_bytes(&em, op, sizeof(op));
+				}
+
+				emit_epilogue(&em, frame_size);
+				break;
+			}
+
+			case OP_PUSH:
+			{
+				SPILL();
+				u64 bits = 0;
+				my_memcpy((i8*)&bits, (i8*)&instr->arg.val, sizeof(t_value));
+				emit_mov_rax(&em, bits);
+				emit_movq_xmm_rax(&em, 0);
+				++sp;
+				break;
+			}
+
+			case OP_LOAD:
+			{
+				SPILL();
+				emit_ctx_arg(&em);
+				emit_mov_rsi(&em, (u64)(prog->names + instr->arg.name));
+				emit_call_abs(&em, (const void*)&jit_load);
+				++sp;
+
+				// return 0 if an error has been reported, so that nothing is stored:
+				// cmp eax, [rsp + diags_offs]; je over the exit; xorpd xmm0, xmm0
+				const u8 op_cmp[] = { 0x3b, 0x84, 0x24 };
+				const u8 op_zero[] = { 0x66, 0x0f, 0x57, 0xc0 };
+				emit_load_diags(&em);
+				emit_bytes(&em, op_cmp, sizeof(op_cmp));
+				emit_u32(&em, diags_offs);
+
+				u64 jump_pos = em.pos + 1;
+				const u8 op_je[] = { 0x74, 0x00 };
+				emit_bytes(&em, op_je, sizeof(op_je));
+				emit_bytes(&em, op_zero, sizeof(op_zero));
+				emit_epilogue(&em, frame_size);
+				em.code[jump_pos] = (u8)(em.pos - jump_pos - 1);
+				break;
+			}
+
+			case OP_STORE:
+				emit_ctx_arg(&em);
+				emit_mov_rsi(&em, (u64)(prog->names + instr->arg.name));
+				emit_call_abs(&em, (const void*)&jit_store);
+				break;
+
+			case OP_ADD:
+			case OP_SUB:
+			case OP_MUL:
+			case OP_DIV:
+			{
+				// xmm1 = rhs, xmm0 = lhs, then addsd/subsd/mulsd/divsd xmm0, xmm1
+				u8 opcode = 0;
+				switch(instr->op)
+				{
+					case OP_ADD: opcode = 0x58; break;
+					case OP_SUB: opcode = 0x5c; break;
+					case OP_MUL: opcode = 0x59; break;
+					case OP_DIV: opcode = 0x5e; break;
+				}
+
+				emit_xmm0_to_xmm1(&em);
+				emit_load_slot(&em, 0, SLOT(sp-2));
+				const u8 op[] = { 0xf2, 0x0f, opcode, 0xc1 };
+				emit_bytes(&em, op, sizeof(op));
+				--sp;
+				break;
+			}
+
+			case OP_MOD:
+			case OP_POW:
+			case OP_CALL2:
+			{
+				const void *func = 0;
+				if(instr->op == OP_MOD)
+					func = (const void*)&fmod;
+				else if(instr->op == OP_POW)
+					func = (const void*)&pow;
+				else
+					func = (const void*)instr->arg.func.f2;
+
+				emit_xmm0_to_xmm1(&em);
+				emit_load_slot(&em, 0, SLOT(sp-2));
+				emit_call_abs(&em, func);
+				--sp;
+				break;
+			}
+
+			case OP_NEG:
+			{
+				// flip the sign bit: xorpd xmm0, xmm1
+				const u8 op[] = { 0x66, 0x0f, 0x57, 0xc1 };
+				emit_mov_rax(&em, 0x8000000000000000ull);
+				emit_movq_xmm_rax(&em, 1);
+				emit_bytes(&em, op, sizeof(op));
+				break;
+			}
+
+			case OP_CALL1:
+				emit_call_abs(&em, (const void*)instr->arg.func.f1);
+				break;
+
+			case OP_TSTORE:
+				emit_store_slot(&em, temps_offs + SLOT(instr->arg.temp));
+				break;
+
+			case OP_TLOAD:
+				SPILL();
+				emit_load_slot(&em, 0, temps_offs + SLOT(instr->arg.temp));
+				++sp;
+				break;
+		}
+	}
+
+	#undef SPILL
+	#undef SLOT
+
+	prog->jit = ctx->jit;
+	prog->jit_code = code;
+	return 1;
+#endif
+}
+// ----------------------------------------------------------------------------
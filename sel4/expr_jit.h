@@ -0,0 +1,41 @@
+/**
+ * compiles expression bytecode to native x86-64 code
+ *
+ * @author agent
+ * @date 16-oct-2026
+ * @license GPLv3, see 'LICENSE' file
+ */
+
+#ifndef __EXPR_JIT_H__
+#define __EXPR_JIT_H__
+
+#include "string.h"
+#include "expr_parser.h"
+#include "expr_code.h"
+
+
+#define JIT_DEFAULT_SIZE (64*1024)  // size of the executable memory mapped on the host
+
+
+typedef t_value (*t_jitfunc)(struct ParserContext*);
+
+
+/**
+ * executable memory, split into blocks which each hold a program's code
+ */
+struct JitBuffer
+{
+	u8 *mem;
+	u64 size;
+	int mapped;     // memory is owned by the buffer
+};
+
+
+extern int init_jit(struct ParserContext* ctx, void* mem, u64 size);
+extern void deinit_jit(struct ParserContext* ctx);
+
+extern int jit_program(struct ParserContext* ctx, struct ExprProgram* prog);
+extern void jit_free(struct JitBuffer* jit, void* code);
+
+
+#endif
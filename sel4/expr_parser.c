@@ -17,6 +17,12 @@
 
 #include "string.h"
 #include "expr_parser.h"
+#include "expr_code.h"
+#include "expr_funcs.h"
+#include "expr_ast.h"
+#include "expr_jit.h"
+#include "expr_deps.h"
+#include "expr_env.h"
 
 
 // ----------------------------------------------------------------------------
@@ -33,777 +39,1746 @@ enum Token
 };
 
 
-static t_value plus_term(struct ParserContext* ctx);
-static t_value plus_term_rest(struct ParserContext* ctx, t_value arg);
-static t_value mul_term(struct ParserContext* ctx);
-static t_value mul_term_rest(struct ParserContext* ctx, t_value arg);
-static t_value pow_term(struct ParserContext* ctx);
-static t_value pow_term_rest(struct ParserContext* ctx, t_value arg);
-static t_value factor(struct ParserContext* ctx);
+static struct AstNode* parse_expr(struct ParserContext* ctx);
 // ----------------------------------------------------------------------------
 
 
 
 // ----------------------------------------------------------------------------
 // symbol table
+// open-addressing hash index over an insertion-ordered symbol array,
+// the symbol names are interned into one contiguous arena
 // ----------------------------------------------------------------------------
 
-struct Symbol* create_symbol(const char* name, t_value value)
+static void init_symboltable(struct SymbolTable* tab, const struct ExprAllocator* alloc)
 {
-	struct Symbol *sym = (struct Symbol*)malloc(sizeof(struct Symbol));
-	if(sym)
-	{
-		my_strncpy(sym->name, name, MAX_IDENT);
-		sym->value = value;
-		sym->next = 0;
-	}
-
-	return sym;
-}
-
-
-struct Symbol* find_symbol(struct ParserContext* ctx, const char* name)
-{
-	struct Symbol* sym = &ctx->symboltable;
+	tab->alloc = alloc;
 
-	while(sym)
-	{
-		if(my_strncmp(sym->name, name, MAX_IDENT) == 0)
-			return sym;
+	tab->syms = 0;
+	tab->num_syms = tab->syms_cap = 0;
 
-		sym = sym->next;
-	}
+	tab->slots = 0;
+	tab->slots_cap = 0;
 
-	return sym;
+	tab->names = 0;
+	tab->names_len = tab->names_cap = 0;
 }
 
 
-struct Symbol* assign_or_insert_symbol(struct ParserContext* ctx, const char* name, t_value value)
+static void deinit_symboltable(struct SymbolTable* tab)
 {
-	struct Symbol* sym = find_symbol(ctx, name);
-
-	if(sym)
-	{
-		sym->value = value;
-	}
-	else
-	{
-		sym = create_symbol(name, value);
-
-		struct Symbol *table = &ctx->symboltable;
-		while(1)
-		{
-			if(table->next == 0)
-			{
-				table->next = sym;
-				break;
-			}
+	for(u32 i=0; i<tab->num_syms; ++i)
+		free_user_func(tab->syms[i].func);
 
-			table = table->next;
-		}
-	}
+	expr_free(tab->alloc, tab->syms);
+	expr_free(tab->alloc, tab->slots);
+	expr_free(tab->alloc, tab->names);
 
-	return sym;
+	init_symboltable(tab, tab->alloc);
 }
 
 
-void print_symbols(struct ParserContext* ctx)
+/**
+ * find the index slot for a name, which is either its symbol's slot or a free one
+ */
+static struct SymbolSlot* lookup_slot(const struct SymbolTable* tab,
+	const char* name, u32 len, u32 hash)
 {
-	const struct Symbol* sym = ctx->symboltable.next;
-	char msg[512];
-	msg[0] = 0;
+	if(!tab->slots_cap)
+		return 0;
 
-	while(sym)
+	u32 mask = tab->slots_cap - 1;
+	for(u32 pos = hash & mask; ; pos = (pos+1) & mask)
 	{
-		my_strncat(msg, "\t", sizeof(msg));
-		my_strncat(msg, sym->name, sizeof(msg));
-		my_strncat(msg, " = ", sizeof(msg));
-		char val[64];
-
-#ifdef USE_INTEGER
-		int_to_str(sym->value, 10, val);
-#else
-		real_to_str(sym->value, 10, val, 8);
-#endif
+		struct SymbolSlot *slot = tab->slots + pos;
+		if(!slot->idx)
+			return slot;
+		if(slot->hash != hash)
+			continue;
 
-		my_strncat(msg, val, sizeof(msg));
-		my_strncat(msg, "\n", sizeof(msg));
-		sym = sym->next;
+		const struct Symbol *sym = tab->syms + slot->idx - 1;
+		if(sym->name_len == len && my_strncmp(tab->names + sym->name, name, len) == 0)
+			return slot;
 	}
-
-	printf("Symbol table:\n%s", msg);
 }
-// ------------------------------------------------------------------------
-
 
 
-// ------------------------------------------------------------------------
-// lexer
-// ------------------------------------------------------------------------
-
-
-#ifdef USE_INTEGER
-
-static int match_int(const char* tok)
+/**
+ * double the size of the hash index
+ */
+static int grow_slots(struct SymbolTable* tab)
 {
-	int len = my_strlen(tok);
+	u32 new_cap = tab->slots_cap ? tab->slots_cap*2 : 64;
+	struct SymbolSlot *new_slots = (struct SymbolSlot*)expr_calloc(tab->alloc,
+		new_cap, sizeof(struct SymbolSlot));
+	if(!new_slots)
+		return 0;
 
-	for(int i=0; i<len; ++i)
+	for(u32 i=0; i<tab->slots_cap; ++i)
 	{
-		if(!my_isdigit(tok[i], 0))
-			return 0;
+		const struct SymbolSlot *slot = tab->slots + i;
+		if(!slot->idx)
+			continue;
+
+		u32 pos = slot->hash & (new_cap-1);
+		while(new_slots[pos].idx)
+			pos = (pos+1) & (new_cap-1);
+		new_slots[pos] = *slot;
 	}
+
+	expr_free(tab->alloc, tab->slots);
+	tab->slots = new_slots;
+	tab->slots_cap = new_cap;
 	return 1;
 }
 
-#else
 
-static int match_real(const char* tok)
+/**
+ * copy a name into the arena
+ * @return offset of the interned name
+ */
+static int intern_name(struct SymbolTable* tab, const char* name, u32 len, u32* offs)
 {
-	int len = my_strlen(tok);
-	int point_seen = 0;
-
-	for(int i=0; i<len; ++i)
+	if(tab->names_len + len + 1 > tab->names_cap)
 	{
-		if(my_isdigit(tok[i], 0))
-			continue;
-		if(tok[i] == '.' && !point_seen)
-		{
-			point_seen = 1;
-			continue;
-		}
-		else
+		u32 new_cap = tab->names_cap ? tab->names_cap*2 : 256;
+		while(new_cap < tab->names_len + len + 1)
+			new_cap *= 2;
+
+		char *new_names = (char*)expr_realloc(tab->alloc, tab->names, new_cap);
+		if(!new_names)
 			return 0;
+
+		tab->names = new_names;
+		tab->names_cap = new_cap;
 	}
+
+	*offs = tab->names_len;
+	my_strncpy(tab->names + tab->names_len, name, len);
+	tab->names[tab->names_len + len] = 0;
+	tab->names_len += len + 1;
 	return 1;
 }
 
-#endif
 
-static int match_ident(const char* tok)
+static struct Symbol* insert_symbol(struct SymbolTable* tab,
+	const char* name, u32 len, u32 hash, t_value value)
 {
-	int len = my_strlen(tok);
-	if(len == 0)
-		return 0;
-	if(!my_isalpha(tok[0]))
+	// keep the load factor below 3/4
+	if((tab->num_syms+1)*4 > tab->slots_cap*3 && !grow_slots(tab))
 		return 0;
 
-	for(int i=1; i<len; ++i)
+	if(tab->num_syms >= tab->syms_cap)
 	{
-		if(!my_isdigit(tok[i], 0) && !my_isalpha(tok[i]))
+		u32 new_cap = tab->syms_cap ? tab->syms_cap*2 : 16;
+		struct Symbol *new_syms = (struct Symbol*)expr_realloc(tab->alloc,
+			tab->syms, new_cap*sizeof(struct Symbol));
+		if(!new_syms)
 			return 0;
-	}
-
-	//printf("Match: %s\n", tok);
-	return 1;
-}
 
-
-/**
- * find all matching tokens for input string
- */
-static int get_matching_token(const char* str, t_value* value)
-{
-#ifdef USE_INTEGER
-	{	// int
-		if(match_int(str))
-		{
-			t_value val = 0;
-			val = my_atoi(str, 10);
-
-			*value = val;
-			return TOK_VALUE;
-		}
+		tab->syms = new_syms;
+		tab->syms_cap = new_cap;
 	}
-#else
-	{	// real
-		if(match_real(str))
-		{
-			t_value val = 0.;
-			val = my_atof(str, 10);
 
-			*value = val;
-			return TOK_VALUE;
-		}
-	}
-#endif
+	u32 name_offs = 0;
+	if(!intern_name(tab, name, len, &name_offs))
+		return 0;
 
-	{	// ident
-		if(match_ident(str))
-		{
-			*value = 0;
-			return TOK_IDENT;
-		}
-	}
+	struct Symbol *sym = tab->syms + tab->num_syms++;
+	sym->name = name_offs;
+	sym->name_len = len;
+	sym->value = value;
+	sym->has_value = 1;
+	sym->func = 0;
 
-	{	// tokens represented by themselves
-		if(my_strcmp(str, "+")==0 || my_strcmp(str, "-")==0 || my_strcmp(str, "*")==0 ||
-			my_strcmp(str, "/")==0 || my_strcmp(str, "%")==0 || my_strcmp(str, "^")==0 ||
-			my_strcmp(str, "(")==0 || my_strcmp(str, ")")==0 || my_strcmp(str, ",")==0 ||
-			my_strcmp(str, "=")==0)
-		{
-			*value = 0;
-			return (int)str[0];
-		}
-	}
+	struct SymbolSlot *slot = lookup_slot(tab, name, len, hash);
+	slot->hash = hash;
+	slot->idx = tab->num_syms;
 
-	*value = 0;
-	return TOK_INVALID;
+	return sym;
 }
 
 
-static void set_input(struct ParserContext* ctx, const char* input)
+const char* symbol_name(const struct ParserContext* ctx, const struct Symbol* sym)
 {
-	ctx->input = input;
-	ctx->input_len = my_strlen(ctx->input);
-	ctx->input_idx = 0;
+	return ctx->symboltable.names + sym->name;
 }
 
 
-static int input_get(struct ParserContext* ctx)
+/**
+ * find a variable by name
+ * the returned pointer is only valid until the next insertion
+ */
+struct Symbol* find_symbol(struct ParserContext* ctx, const char* name)
 {
-	if(ctx->input_idx >= ctx->input_len)
-		return EOF;
+	u32 len = my_strlen(name);
+	u32 hash = (u32)my_strnhash(name, len);
+
+	const struct SymbolSlot *slot = lookup_slot(&ctx->symboltable, name, len, hash);
+	if(!slot || !slot->idx)
+		return 0;
 
-	return ctx->input[ctx->input_idx++];
+	struct Symbol *sym = ctx->symboltable.syms + slot->idx - 1;
+	return sym->has_value ? sym : 0;
 }
 
 
-static int input_peek(struct ParserContext* ctx)
+/**
+ * find a user-defined function by the span of its name
+ */
+struct UserFunc* find_user_func(struct ParserContext* ctx, const char* name, int len)
 {
-	if(ctx->input_idx >= ctx->input_len)
-		return EOF;
+	u32 hash = (u32)my_strnhash(name, len);
+
+	const struct SymbolSlot *slot = lookup_slot(&ctx->symboltable, name, len, hash);
+	if(!slot || !slot->idx)
+		return 0;
 
-	return ctx->input[ctx->input_idx];
+	return ctx->symboltable.syms[slot->idx - 1].func;
 }
 
 
-static void input_putback(struct ParserContext* ctx)
+struct Symbol* assign_or_insert_symbol(struct ParserContext* ctx, const char* name, t_value value)
 {
-	if(ctx->input_idx > 0)
-		--ctx->input_idx;
+	struct SymbolTable *tab = &ctx->symboltable;
+	u32 len = my_strlen(name);
+	u32 hash = (u32)my_strnhash(name, len);
+
+	const struct SymbolSlot *slot = lookup_slot(tab, name, len, hash);
+	if(slot && slot->idx)
+	{
+		struct Symbol *sym = tab->syms + slot->idx - 1;
+		sym->value = value;
+		sym->has_value = 1;
+
+		// the variables depending on this one are recomputed by update_dependents()
+		dep_assigned(ctx, slot->idx - 1);
+		return sym;
+	}
+
+	struct Symbol *sym = insert_symbol(tab, name, len, hash, value);
+	if(!sym)
+		report_error(ctx, EXPR_ERR_MEMORY, -1, 0, name, len);
+
+	return sym;
 }
 
 
-/**
- * @return token, yylval, yytext
- */
-static int lex(struct ParserContext* ctx, t_value* lval, char* text)
+void print_symbols(struct ParserContext* ctx)
 {
-	char input[MAX_IDENT];
-	char longest_input[MAX_IDENT];
-	input[0] = 0;
-	longest_input[0] = 0;
+	const struct SymbolTable *tab = &ctx->symboltable;
 
-	int longest_matching_token = TOK_INVALID;
-	t_value longest_matching_value = 0;
+	// continues in the scratch arena for large tables
+	char mem[512];
+	struct StrBuf msg;
+	strbuf_init(&msg, mem, sizeof(mem));
+	strbuf_use_arena(&msg, &ctx->scratch);
+	strbuf_append(&msg, "Symbol table:\n");
 
-	while(1)
+	for(u32 i=0; i<tab->num_syms; ++i)
 	{
-		int c = input_get(ctx);
-		if(c == EOF)
-			break;
+		const struct Symbol *sym = tab->syms + i;
 
-		// if outside any other match...
-		if(longest_matching_token == TOK_INVALID)
+		if(sym->func)
 		{
-			// ...ignore white spaces
-			if(c==' ' || c=='\t')
-				continue;
-			// ...end on new line
-			if(c=='\n')
-			{
-				*lval = 0;
-				my_strncpy(text, longest_input, MAX_IDENT);
-				return TOK_END;
-			}
+			strbuf_append_char(&msg, '\t');
+			strbuf_append(&msg, symbol_name(ctx, sym));
+			strbuf_append(&msg, "(): function of ");
+			strbuf_append_int(&msg, sym->func->num_params, 10);
+			strbuf_append(&msg, sym->func->memo_cap ? " arguments, memoised\n" : " arguments\n");
 		}
 
-		strncat_char(input, c, MAX_IDENT);
-		t_value matching_val = 0;
-		int matching = get_matching_token(input, &matching_val);
-		if(matching != TOK_INVALID)
-		{
-			my_strncpy(longest_input, input, MAX_IDENT);
-			longest_matching_token = matching;
-			longest_matching_value = matching_val;
-
-			if(input_peek(ctx)==EOF)
-				break;
-		}
-		else
-		{
-			// no more matches
-			input_putback(ctx);
-			break;
-		}
-	}
+		if(!sym->has_value)
+			continue;
 
-	// at EOF
-	if(longest_matching_token == TOK_INVALID && my_strlen(input) == 0)
-	{
-		*lval = 0;
-		my_strncpy(text, longest_input, MAX_IDENT);
-		return TOK_END;
-	}
+		strbuf_append_char(&msg, '\t');
+		strbuf_append(&msg, symbol_name(ctx, sym));
+		strbuf_append(&msg, " = ");
 
-	// nothing matches
-	if(longest_matching_token == TOK_INVALID)
-	{
-		printf("Invalid input in lexer: \"%s\".\n", input);
+#ifdef USE_INTEGER
+		strbuf_append_int(&msg, sym->value, 10);
+#else
+		strbuf_append_real(&msg, sym->value);
+#endif
 
-		*lval = 0;
-		my_strncpy(text, longest_input, MAX_IDENT);
-		return TOK_INVALID;
+		strbuf_append_char(&msg, '\n');
 	}
 
-	// found match
-	if(longest_matching_token != TOK_INVALID)
-	{
-		*lval = longest_matching_value;
-		my_strncpy(text, longest_input, MAX_IDENT);
-		return longest_matching_token;
-	}
+	print_message(ctx, msg.str, msg.len);
+	arena_reset(&ctx->scratch);
+}
 
-	// should not get here
-	*lval = 0;
-	my_strncpy(text, longest_input, MAX_IDENT);
-	return TOK_INVALID;
+
+/**
+ * write to the embedder's console or to stdout
+ */
+void print_message(const struct ParserContext* ctx, const char* str, u64 len)
+{
+	if(ctx->console)
+		ctx->console->write(ctx->console->user, str, len);
+	else
+		printf("%.*s", (int)len, str);
 }
 // ------------------------------------------------------------------------
 
 
 
-// ----------------------------------------------------------------------------
-// lexer interface
-// ----------------------------------------------------------------------------
-static void next_lookahead(struct ParserContext* ctx)
+// ------------------------------------------------------------------------
+// lexer
+// deterministic finite automaton which reads each input character once
+// and reports tokens as spans into the input string
+// ------------------------------------------------------------------------
+
+// character classes
+enum CharClass
 {
-	ctx->lookahead = lex(ctx, &ctx->lookahead_val, ctx->lookahead_text);
-}
+	CC_OTHER = 0,
+	CC_DIGIT,
+	CC_ALPHA,
+	CC_POINT,
+	CC_EXP,         // exponent of a number or part of an identifier
+	CC_SIGN,        // sign of an exponent or operator
+	CC_OP,          // tokens represented by themselves
+	CC_SPACE,
+	CC_NEWLINE,
+
+	CC_NUM
+};
 
 
-static int match(struct ParserContext* ctx, int expected)
+// automaton states
+enum LexState
 {
-	if(ctx->lookahead != expected)
-	{
-		printf("Could not match symbol! Expected: %d, got %d.\n", expected, ctx->lookahead);
-		return 0;
-	}
+	LS_STOP = 0,    // no transition: end of token
+	LS_START,
+	LS_INT,         // integer part of a number
+	LS_FRAC,        // fractional part of a number
+	LS_EXP_MARK,    // 'e' after a number, not yet an exponent
+	LS_EXP_SIGN,    // sign of the exponent, not yet an exponent
+	LS_EXP,         // exponent of a number
+	LS_IDENT,
+	LS_OP,
+
+	LS_NUM
+};
 
-	return 1;
-}
-// ----------------------------------------------------------------------------
 
+static const u8 char_classes[256] =
+{
+	['0' ... '9'] = CC_DIGIT,
+	['a' ... 'd'] = CC_ALPHA, ['e'] = CC_EXP, ['f' ... 'z'] = CC_ALPHA,
+	['A' ... 'D'] = CC_ALPHA, ['E'] = CC_EXP, ['F' ... 'Z'] = CC_ALPHA,
+	['.'] = CC_POINT,
 
+	['+'] = CC_SIGN, ['-'] = CC_SIGN, ['*'] = CC_OP, ['/'] = CC_OP,
+	['%'] = CC_OP, ['^'] = CC_OP, ['('] = CC_OP, [')'] = CC_OP,
+	[','] = CC_OP, ['='] = CC_OP,
 
-// ----------------------------------------------------------------------------
-// productions
-// ----------------------------------------------------------------------------
-/**
- * +,- terms
- * (lowest precedence, 1)
- */
-static t_value plus_term(struct ParserContext* ctx)
+	[' '] = CC_SPACE, ['\t'] = CC_SPACE,
+	['\n'] = CC_NEWLINE,
+};
+
+
+static const u8 lex_transitions[LS_NUM][CC_NUM] =
 {
-	// plus_term -> mul_term plus_term_rest
-	if(ctx->lookahead == '(' || ctx->lookahead == TOK_VALUE || ctx->lookahead == TOK_IDENT)
+	[LS_START] =
 	{
-		t_value term_val = mul_term(ctx);
-		t_value expr_rest_val = plus_term_rest(ctx, term_val);
+		[CC_DIGIT] = LS_INT,
+		[CC_ALPHA] = LS_IDENT,
+		[CC_EXP] = LS_IDENT,
+		[CC_SIGN] = LS_OP,
+		[CC_OP] = LS_OP,
+#ifndef USE_INTEGER
+		[CC_POINT] = LS_FRAC,
+#endif
+	},
 
-		return expr_rest_val;
-	}
-	else if(ctx->lookahead == '+')	// unary +
+	[LS_INT] =
 	{
-		next_lookahead(ctx);
-		t_value term_val = mul_term(ctx);
-		t_value expr_rest_val = plus_term_rest(ctx, term_val);
+		[CC_DIGIT] = LS_INT,
+#ifndef USE_INTEGER
+		[CC_POINT] = LS_FRAC,
+		[CC_EXP] = LS_EXP_MARK,
+#endif
+	},
 
-		return expr_rest_val;
-	}
-	else if(ctx->lookahead == '-')	// unary -
+	[LS_FRAC] =
 	{
-		next_lookahead(ctx);
-		t_value term_val = -mul_term(ctx);
-		t_value expr_rest_val = plus_term_rest(ctx, term_val);
-
-		return expr_rest_val;
-	}
-
-	if(ctx->lookahead == 0 || ctx->lookahead == EOF)
-		return 0;
-
-	printf("Invalid lookahead in %s: %d.\n", __func__, ctx->lookahead);
-	return 0.;
-}
-
+		[CC_DIGIT] = LS_FRAC,
+		[CC_EXP] = LS_EXP_MARK,
+	},
 
-static t_value plus_term_rest(struct ParserContext* ctx, t_value arg)
-{
-	// plus_term_rest -> '+' mul_term plus_term_rest
-	if(ctx->lookahead == '+')
+	[LS_EXP_MARK] =
 	{
-		next_lookahead(ctx);
-		t_value term_val = arg + mul_term(ctx);
-		t_value expr_rest_val = plus_term_rest(ctx, term_val);
+		[CC_DIGIT] = LS_EXP,
+		[CC_SIGN] = LS_EXP_SIGN,
+	},
 
-		return expr_rest_val;
-	}
+	[LS_EXP_SIGN] =
+	{
+		[CC_DIGIT] = LS_EXP,
+	},
 
-	// plus_term_rest -> '-' mul_term plus_term_rest
-	else if(ctx->lookahead == '-')
+	[LS_EXP] =
 	{
-		next_lookahead(ctx);
-		t_value term_val = arg - mul_term(ctx);
-		t_value expr_rest_val = plus_term_rest(ctx, term_val);
+		[CC_DIGIT] = LS_EXP,
+	},
 
-		return expr_rest_val;
-	}
-	// plus_term_rest -> epsilon
-	else if(ctx->lookahead == ')' || ctx->lookahead == TOK_END || ctx->lookahead == ',')
+	[LS_IDENT] =
 	{
-		return arg;
-	}
+		[CC_DIGIT] = LS_IDENT,
+		[CC_ALPHA] = LS_IDENT,
+		[CC_EXP] = LS_IDENT,
+	},
+};
 
-	printf("Invalid lookahead in %s: %d.\n", __func__, ctx->lookahead);
-	return 0.;
+
+/**
+ * @param tokens the already lexed input or 0
+ */
+static void set_input(struct ParserContext* ctx, const char* input, const struct LexToken* tokens)
+{
+	ctx->input = input;
+	ctx->input_len = my_strlen(ctx->input);
+	ctx->input_idx = 0;
+	ctx->tokens = tokens;
 }
 
 
 /**
- * *,/,% terms
- * (precedence 2)
+ * convert a number token in place
+ * @param len length of the token, shortened if an incomplete exponent does not belong to it
  */
-static t_value mul_term(struct ParserContext* ctx)
+static t_value lex_value(const char* str, int* len)
 {
-	// mul_term -> pow_term mul_term_rest
-	if(ctx->lookahead == '(' || ctx->lookahead == TOK_VALUE || ctx->lookahead == TOK_IDENT)
-	{
-		t_value factor_val = pow_term(ctx);
-		t_value term_rest_val = mul_term_rest(ctx, factor_val);
+#ifdef USE_INTEGER
+	i64 val = 0;
+	u64 num_len = my_atoi(str, 10, &val);
+#else
+	f64 val = 0.;
+	u64 num_len = my_atof(str, &val);
+#endif
+
+	// drop an incomplete exponent, a lone point is taken as zero
+	if(num_len && (int)num_len < *len)
+		*len = (int)num_len;
+	return (t_value)val;
+}
 
-		return term_rest_val;
-	}
 
-	printf("Invalid lookahead in %s: %d.\n", __func__, ctx->lookahead);
-	return 0.;
+static int is_number_state(int state)
+{
+	return state == LS_INT || state == LS_FRAC || state == LS_EXP_MARK
+		|| state == LS_EXP_SIGN || state == LS_EXP;
 }
 
 
-static t_value mul_term_rest(struct ParserContext* ctx, t_value arg)
+/**
+ * @return token, yylval, and the token's span in the input
+ */
+static int lex(struct ParserContext* ctx, t_value* lval, int* tok_pos, int* tok_len)
 {
-	// mul_term_rest -> '*' pow_term mul_term_rest
-	if(ctx->lookahead == '*')
-	{
-		next_lookahead(ctx);
-		t_value factor_val = arg * pow_term(ctx);
-		t_value term_rest_val = mul_term_rest(ctx, factor_val);
+	const char *input = ctx->input;
+	int idx = ctx->input_idx;
+	int len = ctx->input_len;
+
+	*lval = 0;
+
+	// skip white spaces
+	while(idx < len && char_classes[(u8)input[idx]] == CC_SPACE)
+		++idx;
 
-		return term_rest_val;
+	*tok_pos = idx;
+	*tok_len = 0;
+
+	// end on new line or at end of input
+	if(idx >= len || char_classes[(u8)input[idx]] == CC_NEWLINE)
+	{
+		ctx->input_idx = idx;
+		return TOK_END;
 	}
 
-	// mul_term_rest -> '/' pow_term mul_term_rest
-	else if(ctx->lookahead == '/')
+	// run the automaton as long as there are transitions
+	int state = LS_START;
+	while(idx < len)
 	{
-		next_lookahead(ctx);
-		t_value factor_val = arg / pow_term(ctx);
-		t_value term_rest_val = mul_term_rest(ctx, factor_val);
+		int next_state = lex_transitions[state][char_classes[(u8)input[idx]]];
+		if(next_state == LS_STOP)
+			break;
+
+		state = next_state;
+		++idx;
 
-		return term_rest_val;
+		// single-character tokens have no further transitions
+		if(state == LS_OP)
+			break;
 	}
 
-	// mul_term_rest -> '%' pow_term mul_term_rest
-	else if(ctx->lookahead == '%')
-	{
-		next_lookahead(ctx);
-		t_value factor_val = fmod(arg, pow_term(ctx));
-		t_value term_rest_val = mul_term_rest(ctx, factor_val);
+	*tok_len = idx - *tok_pos;
+	ctx->input_idx = idx;
 
-		return term_rest_val;
+	if(is_number_state(state))
+	{
+		*lval = lex_value(input + *tok_pos, tok_len);
+		ctx->input_idx = *tok_pos + *tok_len;
+		return TOK_VALUE;
 	}
 
-	// mul_term_rest -> epsilon
-	else if(ctx->lookahead == '+' || ctx->lookahead == '-' || ctx->lookahead == ')'
-		|| ctx->lookahead == TOK_END || ctx->lookahead == ',')
+	switch(state)
 	{
-		return arg;
+		case LS_IDENT:
+			return TOK_IDENT;
+
+		case LS_OP:
+			return (int)input[*tok_pos];
 	}
 
-	printf("Invalid lookahead in %s: %d.\n", __func__, ctx->lookahead);
-	return 0.;
+	// nothing matches
+	report_error(ctx, EXPR_ERR_INVALID_CHAR, idx, 1, input + idx, 1);
+	ctx->input_idx = idx + 1;
+	*tok_len = 1;
+	return TOK_INVALID;
 }
+// ------------------------------------------------------------------------
+
 
 
+// ----------------------------------------------------------------------------
+// line editing
+// runs the lexer's automaton on each typed character, so that the tokens
+// are already known when the line is evaluated
+// ----------------------------------------------------------------------------
+
 /**
- * ^ terms
- * (precedence 3)
+ * @param cap maximum number of characters
  */
-static t_value pow_term(struct ParserContext* ctx)
+int init_line(struct ParserContext* ctx, struct ExprLine* line, int cap)
 {
-	// pow_term -> factor pow_term_rest
-	if(ctx->lookahead == '(' || ctx->lookahead == TOK_VALUE || ctx->lookahead == TOK_IDENT)
-	{
-		t_value factor_val = factor(ctx);
-		t_value term_rest_val = pow_term_rest(ctx, factor_val);
+	// every token takes at least one character, and there is one for the end
+	line->text = (char*)expr_alloc(&ctx->alloc, cap + 1);
+	line->toks = (struct LexToken*)expr_alloc(&ctx->alloc, (cap + 1)*sizeof(struct LexToken));
+	line->cap = cap;
 
-		return term_rest_val;
+	if(!line->text || !line->toks)
+	{
+		deinit_line(ctx, line);
+		return 0;
 	}
 
-	printf("Invalid lookahead in %s: %d.\n", __func__, ctx->lookahead);
-	return 0.;
+	clear_line(line);
+	return 1;
 }
 
 
-static t_value pow_term_rest(struct ParserContext* ctx, t_value arg)
+void deinit_line(struct ParserContext* ctx, struct ExprLine* line)
 {
-	// pow_term_rest -> '^' factor pow_term_rest
-	if(ctx->lookahead == '^')
-	{
-		next_lookahead(ctx);
-		t_value factor_val = pow(arg, factor(ctx));
-		t_value term_rest_val = pow_term_rest(ctx, factor_val);
+	expr_free(&ctx->alloc, line->text);
+	expr_free(&ctx->alloc, line->toks);
 
-		return term_rest_val;
-	}
+	line->text = 0;
+	line->toks = 0;
+	line->cap = 0;
+}
 
-	// pow_term_rest -> epsilon
-	else if(ctx->lookahead == '+' || ctx->lookahead == '-' || ctx->lookahead == ')'
-		|| ctx->lookahead == TOK_END || ctx->lookahead == ','
-		|| ctx->lookahead == '*' || ctx->lookahead == '/' || ctx->lookahead == '%')
-	{
-		return arg;
-	}
 
-	printf("Invalid lookahead in %s: %d.\n", __func__, ctx->lookahead);
-	return 0.;
+void clear_line(struct ExprLine* line)
+{
+	line->len = 0;
+	line->num_toks = 0;
+	line->state = LS_START;
+	line->tok_pos = 0;
+
+	if(line->text)
+		line->text[0] = 0;
 }
 
 
 /**
- * () terms, real factor or identifier
- * (highest precedence, 4)
+ * convert the unfinished token, which ends before the given position
+ * @return end of the token, before the given position if it is a number followed by an incomplete exponent
  */
-static t_value factor(struct ParserContext* ctx)
+static int line_token(const struct ExprLine* line, int end, struct LexToken* tok)
 {
-	// factor -> '(' plus_term ')'
-	if(ctx->lookahead == '(')
-	{
-		next_lookahead(ctx);
-		t_value expr_val = plus_term(ctx);
-		match(ctx, ')');
-		next_lookahead(ctx);
+	tok->pos = line->tok_pos;
+	tok->len = end - line->tok_pos;
+	tok->val = 0;
 
-		return expr_val;
+	if(is_number_state(line->state))
+	{
+		tok->tok = TOK_VALUE;
+		tok->val = lex_value(line->text + tok->pos, &tok->len);
+		return tok->pos + tok->len;
 	}
 
-	// factor -> TOK_VALUE
-	else if(ctx->lookahead == TOK_VALUE)
+	switch(line->state)
 	{
-		t_value val = ctx->lookahead_val;
-		next_lookahead(ctx);
+		case LS_IDENT:
+			tok->tok = TOK_IDENT;
+			break;
+
+		case LS_OP:
+			tok->tok = (int)line->text[tok->pos];
+			break;
+	}
+
+	return end;
+}
+
+
+/**
+ * advance the automaton by the character at the given position
+ */
+static void line_lex_char(struct ExprLine* line, int idx)
+{
+	int cc = char_classes[(u8)line->text[idx]];
+
+	if(line->state != LS_START)
+	{
+		int next_state = lex_transitions[line->state][cc];
+		if(next_state != LS_STOP)
+		{
+			line->state = next_state;
+			return;
+		}
+
+		// the character ends the current token
+		int tok_end = line_token(line, idx, line->toks + line->num_toks++);
+		line->state = LS_START;
+
+		// lex an incomplete exponent again as other tokens, together with this character
+		if(tok_end < idx)
+		{
+			for(int i=tok_end; i<=idx; ++i)
+				line_lex_char(line, i);
+			return;
+		}
+	}
+
+	if(cc == CC_SPACE)
+		return;
+
+	line->tok_pos = idx;
+	line->state = lex_transitions[LS_START][cc];
+
+	// nothing matches, the error is reported when the line is parsed
+	if(line->state == LS_STOP)
+	{
+		struct LexToken *tok = line->toks + line->num_toks++;
+		tok->tok = TOK_INVALID;
+		tok->pos = idx;
+		tok->len = 1;
+		tok->val = 0;
+
+		line->state = LS_START;
+	}
+}
+
+
+/**
+ * append a character
+ * @return 0 if the line is full
+ */
+int line_insert(struct ExprLine* line, char c)
+{
+	if(line->len >= line->cap || char_classes[(u8)c] == CC_NEWLINE)
+		return 0;
+
+	line->text[line->len] = c;
+	line->text[++line->len] = 0;
+
+	line_lex_char(line, line->len - 1);
+	return 1;
+}
+
+
+/**
+ * remove the last character
+ * @return 0 if the line is empty
+ */
+int line_erase(struct ExprLine* line)
+{
+	if(!line->len)
+		return 0;
+
+	line->text[--line->len] = 0;
+
+	// drop the tokens which may have seen the removed character: a number
+	// is ended up to two characters behind it by an incomplete exponent,
+	// whose characters then also form the tokens following the number
+	while(line->num_toks)
+	{
+		const struct LexToken *tok = line->toks + line->num_toks - 1;
+		if(tok->pos + tok->len + 2 < line->len)
+			break;
+		--line->num_toks;
+	}
+
+	// lex again after the last remaining token
+	int idx = 0;
+	if(line->num_toks)
+		idx = line->toks[line->num_toks - 1].pos + line->toks[line->num_toks - 1].len;
+
+	line->state = LS_START;
+	for(; idx < line->len; ++idx)
+		line_lex_char(line, idx);
+
+	return 1;
+}
+// ----------------------------------------------------------------------------
+
+
+
+// ----------------------------------------------------------------------------
+// lexer interface
+// ----------------------------------------------------------------------------
+static void next_lookahead(struct ParserContext* ctx)
+{
+	if(!ctx->tokens)
+	{
+		ctx->lookahead = lex(ctx, &ctx->lookahead_val, &ctx->lookahead_pos, &ctx->lookahead_len);
+		return;
+	}
+
+	// take the next pre-lexed token, staying at the end
+	const struct LexToken *tok = ctx->tokens + ctx->input_idx;
+	if(tok->tok != TOK_END)
+		++ctx->input_idx;
+
+	ctx->lookahead = tok->tok;
+	ctx->lookahead_val = tok->val;
+	ctx->lookahead_pos = tok->pos;
+	ctx->lookahead_len = tok->len;
+
+	if(tok->tok == TOK_INVALID)
+		report_error(ctx, EXPR_ERR_INVALID_CHAR, tok->pos, 1, ctx->input + tok->pos, 1);
+}
+
+
+/**
+ * report an error concerning a span of the input
+ */
+static struct AstNode* syntax_error(struct ParserContext* ctx, int code,
+	const char* text, int text_len)
+{
+	report_error(ctx, code, text - ctx->input, text_len, text, text_len);
+	return 0;
+}
+
+
+static struct AstNode* invalid_lookahead(struct ParserContext* ctx)
+{
+	// already reported by the lexer
+	if(ctx->lookahead == TOK_INVALID)
+		return 0;
+
+	const char *tok = ctx->input + ctx->lookahead_pos;
+	if(ctx->lookahead == TOK_END)
+		return syntax_error(ctx, EXPR_ERR_INCOMPLETE, tok, 0);
+	return syntax_error(ctx, EXPR_ERR_UNEXPECTED, tok, ctx->lookahead_len);
+}
+// ----------------------------------------------------------------------------
+
+
+
+// ----------------------------------------------------------------------------
+// operator-precedence parser
+// builds the syntax tree using ctx->ast, keeping the pending operators and
+// operands on explicit stacks, so that its native stack usage is constant
+// ----------------------------------------------------------------------------
+
+/**
+ * binding strengths, operators on the stack are reduced
+ * while they bind at least as strongly as the incoming one
+ */
+enum Precedence
+{
+	PREC_FRAME  = 0,    // parentheses and function calls, only closed explicitly
+	PREC_CLOSE  = 1,    // ')', ',' and the end of the input
+	PREC_ASSIGN = 2,
+	PREC_PLUS   = 3,    // binary +, -
+	PREC_NEG    = 4,    // unary -, applies to a whole product
+	PREC_MUL    = 5,    // *, /, %
+	PREC_POW    = 6,    // ^
+};
+
+
+enum ParseOpKind
+{
+	PARSE_BINARY,
+	PARSE_NEG,
+	PARSE_ASSIGN,
+	PARSE_PAREN,
+	PARSE_CALL,
+};
+
+
+struct ParseOp
+{
+	int kind;
+	int op;             // PARSE_BINARY: opcode
+	int prec;
+
+	const char *ident;  // PARSE_ASSIGN, PARSE_CALL: span in the input
+	int ident_len;
+	int base;           // PARSE_CALL: operand stack index of the first argument
+};
+
+
+/**
+ * head of the function definition being compiled, its parameters are spans in the input
+ */
+struct FuncDef
+{
+	const char *name;
+	int name_len;
+
+	const char *params[FUNC_MAX_PARAMS];
+	int param_lens[FUNC_MAX_PARAMS];
+	int num_params;
+
+	struct UserFunc *func;  // function being defined
+	int assume_pure;        // purity assumed for recursive calls
+	int calls_user;         // the body calls other user-defined functions
+};
+
+
+struct ParseStacks
+{
+	struct ParseOp *ops;
+	int num_ops;
+
+	struct AstNode **nodes;
+	int num_nodes;
+
+	int cap;
+};
+
+
+static int push_op(struct ParserContext* ctx, struct ParseStacks* st,
+	int kind, int op, int prec)
+{
+	if(st->num_ops >= st->cap)
+	{
+		syntax_error(ctx, EXPR_ERR_NESTING, ctx->input + ctx->lookahead_pos, ctx->lookahead_len);
+		return 0;
+	}
+
+	struct ParseOp *entry = st->ops + st->num_ops++;
+	entry->kind = kind;
+	entry->op = op;
+	entry->prec = prec;
+	entry->ident = 0;
+	entry->ident_len = 0;
+	entry->base = st->num_nodes;
+	return 1;
+}
+
+
+/**
+ * push an operand, a null node means that building the tree has failed
+ */
+static int push_node(struct ParserContext* ctx, struct ParseStacks* st, struct AstNode* node)
+{
+	if(!node)
+		return 0;
+
+	if(st->num_nodes >= st->cap)
+	{
+		syntax_error(ctx, EXPR_ERR_NESTING, ctx->input + ctx->lookahead_pos, ctx->lookahead_len);
+		return 0;
+	}
+
+	st->nodes[st->num_nodes++] = node;
+	return 1;
+}
+
+
+/**
+ * apply the operators which bind at least as strongly as the given precedence
+ */
+static int reduce(struct ParserContext* ctx, struct ParseStacks* st, int prec)
+{
+	while(st->num_ops && st->ops[st->num_ops-1].prec >= prec)
+	{
+		const struct ParseOp *op = st->ops + --st->num_ops;
+		struct AstNode *node = 0;
+
+		switch(op->kind)
+		{
+			case PARSE_BINARY:
+			{
+				struct AstNode *rhs = st->nodes[--st->num_nodes];
+				struct AstNode *lhs = st->nodes[--st->num_nodes];
+				node = ast_binary(ctx->ast, op->op, lhs, rhs);
+				break;
+			}
+
+			case PARSE_NEG:
+				node = ast_unary(ctx->ast, OP_NEG, st->nodes[--st->num_nodes]);
+				break;
+
+			case PARSE_ASSIGN:
+				node = ast_assign(ctx->ast, op->ident, op->ident_len,
+					st->nodes[--st->num_nodes]);
+				break;
+		}
+
+		if(!push_node(ctx, st, node))
+			return 0;
+	}
+
+	return 1;
+}
+
+
+/**
+ * @return index of a parameter of the function being defined, -1 if there is none
+ */
+static int find_param(const struct ParserContext* ctx, const char* name, int len)
+{
+	const struct FuncDef *def = ctx->def;
+	if(!def)
+		return -1;
+
+	for(int i=0; i<def->num_params; ++i)
+	{
+		if(def->param_lens[i] == len && my_strncmp(def->params[i], name, len) == 0)
+			return i;
+	}
+
+	return -1;
+}
+
+
+static int is_name(const char* ident, int ident_len, const char* name, int name_len)
+{
+	return ident_len == name_len && my_strncmp(ident, name, name_len) == 0;
+}
+
+
+/**
+ * find a user-defined function, including the one being defined
+ * @param pure is set if the result only depends on the arguments
+ */
+static struct UserFunc* find_user_call(struct ParserContext* ctx,
+	const char* ident, int ident_len, int num_args, int* pure)
+{
+	struct FuncDef *def = ctx->def;
+	if(def && def->num_params == num_args && is_name(ident, ident_len, def->name, def->name_len))
+	{
+		*pure = def->assume_pure;
+		return def->func;
+	}
+
+	struct UserFunc *func = find_user_func(ctx, ident, ident_len);
+	if(!func || func->num_params != num_args)
+		return 0;
+
+	if(def)
+		def->calls_user = 1;
+	*pure = func->pure;
+	return func;
+}
+
+
+/**
+ * replace the call frame on top of the stack and its arguments by the call
+ */
+static int close_call(struct ParserContext* ctx, struct ParseStacks* st)
+{
+	const struct ParseOp *frame = st->ops + --st->num_ops;
+	int num_args = st->num_nodes - frame->base;
+	struct AstNode **args = st->nodes + frame->base;
+
+	if(num_args > EXPR_MAX_STACK)
+	{
+		syntax_error(ctx, EXPR_ERR_TOO_MANY_ARGS, frame->ident, frame->ident_len);
+		return 0;
+	}
+
+	// conditional, only one of the values is evaluated
+	if(num_args == 3 && is_name(frame->ident, frame->ident_len, "if", 2))
+	{
+		st->num_nodes = frame->base;
+		return push_node(ctx, st, ast_if(ctx->ast, args[0], args[1], args[2]));
+	}
+
+	// user-defined functions take precedence
+	int pure = 0;
+	struct UserFunc *ufunc = find_user_call(ctx, frame->ident, frame->ident_len, num_args, &pure);
+	if(ufunc)
+	{
+		st->num_nodes = frame->base;
+		return push_node(ctx, st, ast_user_call(ctx->ast, ufunc, pure, args, num_args));
+	}
+
+	union Func func;
+	int arity = find_func(ctx, frame->ident, frame->ident_len, num_args, &func, &pure);
+	if(arity < 0)
+	{
+		syntax_error(ctx, EXPR_ERR_UNKNOWN_FUNC, frame->ident, frame->ident_len);
+		return 0;
+	}
+
+	st->num_nodes = frame->base;
+	return push_node(ctx, st, ast_call(ctx->ast, arity, func, pure, args, num_args));
+}
+
+
+/**
+ * expr -> ['+' | '-'] operand { binop operand }
+ * operand -> '(' expr ')' | TOK_VALUE | TOK_IDENT | TOK_IDENT '=' expr
+ *	| TOK_IDENT '(' [expr { ',' expr }] ')'
+ * a call of "if" with three arguments is a conditional
+ * binop -> '+' | '-' | '*' | '/' | '%' | '^'
+ */
+static struct AstNode* parse_expr(struct ParserContext* ctx)
+{
+	struct ParseStacks st;
+	st.cap = ctx->max_ops;
+	st.num_ops = st.num_nodes = 0;
+	st.ops = (struct ParseOp*)arena_alloc(ctx->ast->arena, st.cap * sizeof(struct ParseOp));
+	st.nodes = (struct AstNode**)arena_alloc(ctx->ast->arena, st.cap * sizeof(struct AstNode*));
+	if(!st.ops || !st.nodes)
+		return 0;
+
+	int expect_operand = 1;     // otherwise an operator or a closing token is expected
+	int allow_sign = 1;         // at the start of an expression
+
+	while(1)
+	{
+		int tok = ctx->lookahead;
+
+		if(expect_operand)
+		{
+			if(tok == '(')
+			{
+				if(!push_op(ctx, &st, PARSE_PAREN, 0, PREC_FRAME))
+					return 0;
+				allow_sign = 1;
+			}
+
+			else if(tok == TOK_VALUE)
+			{
+				if(!push_node(ctx, &st, ast_value(ctx->ast, ctx->lookahead_val)))
+					return 0;
+				expect_operand = 0;
+			}
+
+			else if(tok == TOK_IDENT)
+			{
+				const char *ident = ctx->input + ctx->lookahead_pos;
+				int ident_len = ctx->lookahead_len;
+				next_lookahead(ctx);
+
+				// function call
+				if(ctx->lookahead == '(')
+				{
+					if(!push_op(ctx, &st, PARSE_CALL, 0, PREC_FRAME))
+						return 0;
+					st.ops[st.num_ops-1].ident = ident;
+					st.ops[st.num_ops-1].ident_len = ident_len;
+
+					next_lookahead(ctx);
+					if(ctx->lookahead == ')')
+					{
+						if(!close_call(ctx, &st))
+							return 0;
+						expect_operand = 0;
+					}
+					else
+					{
+						// the lookahead is already the first argument
+						allow_sign = 1;
+						continue;
+					}
+				}
+
+				// assignment
+				else if(ctx->lookahead == '=')
+				{
+					t_value val;
+					if(find_const(ctx, ident, ident_len, &val) || find_param(ctx, ident, ident_len) >= 0)
+						return syntax_error(ctx, EXPR_ERR_CONST_ASSIGN, ident, ident_len);
+
+					if(!push_op(ctx, &st, PARSE_ASSIGN, 0, PREC_ASSIGN))
+						return 0;
+					st.ops[st.num_ops-1].ident = ident;
+					st.ops[st.num_ops-1].ident_len = ident_len;
+					allow_sign = 1;
+				}
+
+				// parameter, constant or variable lookup, the lookahead is already the next token
+				else
+				{
+					t_value val;
+					int param = find_param(ctx, ident, ident_len);
+					struct AstNode *node = 0;
+					if(param >= 0)
+						node = ast_param(ctx->ast, param);
+					else if(find_const(ctx, ident, ident_len, &val))
+						node = ast_value(ctx->ast, val);
+					else
+						node = ast_var(ctx->ast, ident, ident_len);
+					if(!push_node(ctx, &st, node))
+						return 0;
+
+					expect_operand = 0;
+					continue;
+				}
+			}
+
+			else if((tok == '-' || tok == '+') && allow_sign)
+			{
+				if(tok == '-' && !push_op(ctx, &st, PARSE_NEG, 0, PREC_NEG))
+					return 0;
+				allow_sign = 0;
+			}
+
+			else
+			{
+				return invalid_lookahead(ctx);
+			}
+		}
+		else
+		{
+			int op = -1, prec = 0;
+			switch(tok)
+			{
+				case '+': op = OP_ADD; prec = PREC_PLUS; break;
+				case '-': op = OP_SUB; prec = PREC_PLUS; break;
+				case '*': op = OP_MUL; prec = PREC_MUL; break;
+				case '/': op = OP_DIV; prec = PREC_MUL; break;
+				case '%': op = OP_MOD; prec = PREC_MUL; break;
+				case '^': op = OP_POW; prec = PREC_POW; break;
+			}
+
+			// binary operator, all operators are left-associative
+			if(op >= 0)
+			{
+				if(!reduce(ctx, &st, prec) || !push_op(ctx, &st, PARSE_BINARY, op, prec))
+					return 0;
+				expect_operand = 1;
+				allow_sign = 0;
+			}
+
+			else if(tok == ')' || tok == ',')
+			{
+				if(!reduce(ctx, &st, PREC_CLOSE))
+					return 0;
+
+				const struct ParseOp *frame = st.num_ops ? st.ops + st.num_ops-1 : 0;
+				if(frame && frame->kind == PARSE_CALL)
+				{
+					if(tok == ')' && !close_call(ctx, &st))
+						return 0;
+				}
+				else if(frame && tok == ')')
+				{
+					// PARSE_PAREN, the enclosed expression stays on the operand stack
+					--st.num_ops;
+				}
+				else
+				{
+					return invalid_lookahead(ctx);
+				}
+
+				// after ',' the next argument follows
+				expect_operand = allow_sign = (tok == ',');
+			}
+
+			else if(tok == TOK_END)
+			{
+				if(!reduce(ctx, &st, PREC_CLOSE))
+					return 0;
+
+				// unclosed parenthesis or function call
+				if(st.num_ops)
+				{
+					const struct ParseOp *frame = st.ops + st.num_ops-1;
+					if(frame->kind == PARSE_CALL)
+						return syntax_error(ctx, EXPR_ERR_UNMATCHED, frame->ident, frame->ident_len);
+					return syntax_error(ctx, EXPR_ERR_UNMATCHED, ctx->input + ctx->lookahead_pos, 0);
+				}
+
+				return st.nodes[0];
+			}
+
+			else
+			{
+				return invalid_lookahead(ctx);
+			}
+		}
+
+		next_lookahead(ctx);
+	}
+}
+// ----------------------------------------------------------------------------
+
+
+
+// ----------------------------------------------------------------------------
+// parser interface
+// ----------------------------------------------------------------------------
 
-		return val;
+/**
+ * initialise the context after its allocators have been set up
+ * @return 1 on success, otherwise a memory error is reported
+ */
+static int init_parser_common(struct ParserContext* ctx)
+{
+	ctx->diags.count = ctx->diags.first = 0;
+
+	ctx->lookahead = TOK_INVALID;
+	ctx->lookahead_val = 0;
+	ctx->lookahead_pos = 0;
+	ctx->lookahead_len = 0;
+
+	ctx->input_idx = 0;
+	ctx->input_len = 0;
+	ctx->input = 0;
+	ctx->tokens = 0;
+
+	init_symboltable(&ctx->symboltable, &ctx->alloc);
+
+	ctx->prog = 0;
+	ctx->ast = 0;
+	ctx->cache = create_cache(&ctx->alloc);
+	ctx->funcs = create_func_registry(&ctx->alloc);
+	ctx->shared_env = 0;
+	ctx->env = 0;
+	ctx->jit = 0;
+	ctx->max_ops = EXPR_MAX_OPS;
+
+	ctx->def = 0;
+	ctx->calls = 0;
+	ctx->memo_size = FUNC_MEMO_SIZE;
+	ctx->deps = 0;
+	ctx->pool = 0;
+	ctx->console = 0;
+
+	if(!ctx->cache || !ctx->funcs)
+	{
+		report_error(ctx, EXPR_ERR_MEMORY, -1, 0, 0, 0);
+		return 0;
 	}
 
-	// factor -> TOK_IDENT
-	else if(ctx->lookahead == TOK_IDENT)
+	return 1;
+}
+
+
+/**
+ * use the default allocators, requesting their memory from libc
+ * @return 1 on success, 0 if the context's data could not be allocated
+ */
+int init_parser(struct ParserContext* ctx)
+{
+	heap_init(&ctx->heap, 0, 0, &libc_allocator);
+	ctx->alloc = heap_allocator(&ctx->heap);
+	arena_init(&ctx->scratch, 0, 0, &libc_allocator);
+
+	return init_parser_common(ctx);
+}
+
+
+/**
+ * use the default allocators within a fixed memory region, without needing libc
+ * @return 1 on success, 0 if the context's data could not be allocated
+ */
+int init_parser_mem(struct ParserContext* ctx, void* mem, u64 size)
+{
+	// a quarter of the memory for temporary data, the rest for the heap
+	u64 scratch_size = (size / 4) & ~(u64)(ARENA_ALIGN-1);
+	arena_init(&ctx->scratch, mem, scratch_size, 0);
+	heap_init(&ctx->heap, (u8*)mem + scratch_size, size - scratch_size, 0);
+	ctx->alloc = heap_allocator(&ctx->heap);
+
+	return init_parser_common(ctx);
+}
+
+
+/**
+ * use an allocator given by the embedder
+ * @return 1 on success, 0 if the context's data could not be allocated
+ */
+int init_parser_alloc(struct ParserContext* ctx, const struct ExprAllocator* alloc)
+{
+	ctx->alloc = *alloc;
+	heap_init(&ctx->heap, 0, 0, 0);
+	arena_init(&ctx->scratch, 0, 0, &ctx->alloc);
+
+	return init_parser_common(ctx);
+}
+
+
+void deinit_parser(struct ParserContext* ctx)
+{
+	// the default allocators release everything at once
+	if(!ctx->alloc.bulk_free)
 	{
-		char ident[MAX_IDENT];
-		my_strncpy(ident, ctx->lookahead_text, MAX_IDENT);
+		deinit_symboltable(&ctx->symboltable);
+		free_cache(ctx->cache);
+		free_func_registry(ctx->funcs);
+		expr_free(&ctx->alloc, ctx->calls);
+		free_dep_graph(ctx->deps);
+	}
 
-		next_lookahead(ctx);
+	ctx->cache = 0;
+	ctx->funcs = 0;
+	ctx->calls = 0;
+	ctx->deps = 0;
+
+	// the snapshot belongs to the shared environment's allocator
+	release_env(ctx->env);
+	ctx->env = 0;
+	ctx->shared_env = 0;
+
+	// after the cache, which frees the programs' native code
+	deinit_jit(ctx);
+
+	arena_deinit(&ctx->scratch);
+	heap_deinit(&ctx->heap);
+}
+
+
+/**
+ * compile the expression at the lookahead into an optimised bytecode program
+ * @param pure is set if the value only depends on parameters and constants
+ */
+static struct ExprProgram* compile_expr(struct ParserContext* ctx, int* pure)
+{
+	struct ExprProgram *prog = create_program(&ctx->alloc);
+	if(!prog)
+		return 0;
+
+	struct AstBuilder ast;
+	init_ast_builder(&ast, &ctx->scratch);
+	u32 diags_before = ctx->diags.count;
+
+	ctx->prog = prog;
+	ctx->ast = &ast;
+
+	struct AstNode *root = parse_expr(ctx);
+
+	// an allocation might have failed while building the tree
+	if(!root && !prog->error)
+		report_error(ctx, EXPR_ERR_MEMORY, -1, 0, 0, 0);
+
+	if(!prog->error && !ast_codegen(&ast, root, prog))
+		report_error(ctx, EXPR_ERR_MEMORY, -1, 0, 0, 0);
+
+	emit_op(prog, OP_END);
+
+	// errors found while emitting the code
+	if(prog->error && ctx->diags.count == diags_before)
+		report_error(ctx, prog->error, -1, 0, 0, 0);
+
+	if(pure)
+		*pure = root && root->pure && !root->reads_vars;
+
+	deinit_ast_builder(&ast);
+	ctx->ast = 0;
+	ctx->prog = 0;
+
+	return prog;
+}
+
+
+/**
+ * match the head of a function definition, ident '(' [ident {',' ident}] ')' '='
+ * @return 1 if it matches, the lookahead is then the first token of the body
+ */
+static int match_head(struct ParserContext* ctx, struct FuncDef* def)
+{
+	if(ctx->lookahead != TOK_IDENT)
+		return 0;
+
+	def->name = ctx->input + ctx->lookahead_pos;
+	def->name_len = ctx->lookahead_len;
+	def->num_params = 0;
+
+	next_lookahead(ctx);
+	if(ctx->lookahead != '(')
+		return 0;
+
+	next_lookahead(ctx);
+	while(ctx->lookahead != ')')
+	{
+		if(ctx->lookahead != TOK_IDENT)
+			return 0;
 
-		// function call
-		// using next ctx->lookahead, grammar still ll(1)?
-		if(ctx->lookahead == '(')
+		// the number of parameters is checked once the definition is recognised
+		if(def->num_params < FUNC_MAX_PARAMS)
 		{
+			def->params[def->num_params] = ctx->input + ctx->lookahead_pos;
+			def->param_lens[def->num_params] = ctx->lookahead_len;
+		}
+		++def->num_params;
+
+		next_lookahead(ctx);
+		if(ctx->lookahead == ',')
 			next_lookahead(ctx);
+		else if(ctx->lookahead != ')')
+			return 0;
+	}
 
-			// 0-argument function
-			// factor -> TOK_IDENT '(' ')'
-			if(ctx->lookahead == ')')
-			{
-				next_lookahead(ctx);
+	next_lookahead(ctx);
+	if(ctx->lookahead != '=')
+		return 0;
 
-				// TODO
-				//auto iter = m_mapFuncs0.find(ident);
-				//if(iter == m_mapFuncs0.end())
-				{
-					printf("Unknown function: \"%s\".\n", ident);
-					return 0.;
-				}
+	next_lookahead(ctx);
+	return 1;
+}
 
-				//return (*iter->second)();
-			}
 
-			// function with arguments
-			else
-			{
-				// first argument
-				t_value expr_val1 = plus_term(ctx);
+/**
+ * check if the input starts with a function definition, otherwise rewind it
+ */
+static int match_definition(struct ParserContext* ctx, struct FuncDef* def)
+{
+	if(ctx->lookahead != TOK_IDENT)
+		return 0;
 
-				// one-argument-function
-				// factor -> TOK_IDENT '(' plus_term ')'
-				if(ctx->lookahead == ')')
-				{
-					next_lookahead(ctx);
+	// lexer errors are reported again when the input is parsed as an expression
+	struct DiagRing diags = ctx->diags;
+	if(match_head(ctx, def))
+		return 1;
 
-					if(my_strncmp(ident, "sqrt", MAX_IDENT)==0)
-					{
-						return sqrt(expr_val1);
-					}
-					else if(my_strncmp(ident, "sin", MAX_IDENT)==0)
-					{
-						return sin(expr_val1);
-					}
-					else if(my_strncmp(ident, "cos", MAX_IDENT)==0)
-					{
-						return cos(expr_val1);
-					}
-					else if(my_strncmp(ident, "tan", MAX_IDENT)==0)
-					{
-						return tan(expr_val1);
-					}
-					else if(my_strncmp(ident, "asin", MAX_IDENT)==0)
-					{
-						return asin(expr_val1);
-					}
-					else if(my_strncmp(ident, "acos", MAX_IDENT)==0)
-					{
-						return acos(expr_val1);
-					}
-					else if(my_strncmp(ident, "atan", MAX_IDENT)==0)
-					{
-						return atan(expr_val1);
-					}
-					else if(my_strncmp(ident, "log", MAX_IDENT)==0)
-					{
-						return log(expr_val1);
-					}
-					else if(my_strncmp(ident, "log2", MAX_IDENT)==0)
-					{
-						return log2(expr_val1);
-					}
-					else if(my_strncmp(ident, "log10", MAX_IDENT)==0)
-					{
-						return log10(expr_val1);
-					}
-					else
-					{
-						printf("Unknown function: \"%s\".\n", ident);
-						return 0.;
-					}
-				}
+	ctx->diags = diags;
+	ctx->input_idx = 0;
+	next_lookahead(ctx);
+	return 0;
+}
 
-				// two-argument-function
-				// factor -> TOK_IDENT '(' plus_term ',' plus_term ')'
-				else if(ctx->lookahead == ',')
-				{
-					next_lookahead(ctx);
-					t_value expr_val2 = plus_term(ctx);
-					match(ctx, ')');
-					next_lookahead(ctx);
 
-					if(my_strncmp(ident, "atan2", MAX_IDENT)==0)
-					{
-						return atan2(expr_val1, expr_val2);
-					}
-					else if(my_strncmp(ident, "pow", MAX_IDENT)==0)
-					{
-						return pow(expr_val1, expr_val2);
-					}
-					else
-					{
-						printf("Unknown function: \"%s\".\n", ident);
-						return 0.;
-					}
-				}
-				else
-				{
-					printf("Invalid function call to \"%s\".\n", ident);
-				}
-			}
+/**
+ * program which only carries an error concerning a span of the input
+ */
+static struct ExprProgram* error_program(struct ParserContext* ctx, int code,
+	const char* text, int text_len)
+{
+	struct ExprProgram *prog = create_program(&ctx->alloc);
+	if(!prog)
+		return 0;
+
+	ctx->prog = prog;
+	syntax_error(ctx, code, text, text_len);
+	ctx->prog = 0;
+	return prog;
+}
+
+
+/**
+ * install a compiled body, taking ownership of it
+ * @return 0 if the function's symbol cannot be inserted
+ */
+static int define_func(struct ParserContext* ctx, const struct FuncDef* def,
+	struct ExprProgram* body, int pure)
+{
+	struct SymbolTable *tab = &ctx->symboltable;
+	struct UserFunc *func = def->func;
+	u32 hash = (u32)my_strnhash(def->name, def->name_len);
+
+	const struct SymbolSlot *slot = lookup_slot(tab, def->name, def->name_len, hash);
+	struct Symbol *sym = slot && slot->idx ? tab->syms + slot->idx - 1 : 0;
+	if(!sym)
+	{
+		sym = insert_symbol(tab, def->name, def->name_len, hash, 0);
+		if(!sym)
+		{
+			report_error(ctx, EXPR_ERR_MEMORY, -1, 0, def->name, def->name_len);
+			return 0;
 		}
 
-		// assignment
-		else if(ctx->lookahead == '=')
+		sym->has_value = 0;
+	}
+
+	int redefined = func->prog != 0;
+	sym->func = func;
+
+	free_program(func->prog);
+	func->prog = body;
+	func->num_params = def->num_params;
+	func->pure = pure;
+	func->calls_user = def->calls_user;
+
+	// memoisation is optional, the function also works without it
+	init_memo(func, pure ? ctx->memo_size : 0);
+
+	// the purity of the callers was determined using the previous definition
+	if(redefined)
+	{
+		for(u32 i=0; i<tab->num_syms; ++i)
 		{
-			next_lookahead(ctx);
-			t_value assign_val = plus_term(ctx);
-			assign_or_insert_symbol(ctx, ident, assign_val);
-			return assign_val;
+			struct UserFunc *caller = tab->syms[i].func;
+			if(!caller || caller == func || !caller->calls_user)
+				continue;
+
+			caller->pure = 0;
+			init_memo(caller, 0);
 		}
+	}
 
-		// variable lookup
-		else
+	// cached programs might have been compiled against the previous definition
+	invalidate_programs(ctx);
+	return 1;
+}
+
+
+/**
+ * compile the body of a function, which is defined if there are no errors
+ * @return program of the definition itself, which evaluates to 0
+ */
+static struct ExprProgram* compile_definition(struct ParserContext* ctx, struct FuncDef* def)
+{
+	if(is_name(def->name, def->name_len, "if", 2))
+		return error_program(ctx, EXPR_ERR_UNEXPECTED, def->name, def->name_len);
+	if(def->num_params > FUNC_MAX_PARAMS)
+		return error_program(ctx, EXPR_ERR_TOO_MANY_ARGS, def->name, def->name_len);
+
+	for(int i=1; i<def->num_params; ++i)
+	{
+		for(int j=0; j<i; ++j)
 		{
-			const struct Symbol* sym = find_symbol(ctx, ident);
-			if(!sym)
-			{
-				printf("Unknown identifier \"%s\".\n", ident);
-				return 0.;
-			}
+			if(is_name(def->params[i], def->param_lens[i], def->params[j], def->param_lens[j]))
+				return error_program(ctx, EXPR_ERR_UNEXPECTED, def->params[i], def->param_lens[i]);
+		}
+	}
+
+	// a redefinition keeps the function, as compiled programs refer to it
+	struct UserFunc *func = find_user_func(ctx, def->name, def->name_len);
+	int is_new = !func;
+	if(is_new)
+	{
+		func = create_user_func(&ctx->alloc, def->name, def->name_len);
+		if(!func)
+			return 0;
+	}
 
-			return sym->value;
+	def->func = func;
+	def->assume_pure = 1;
+	def->calls_user = 0;
+	ctx->def = def;
+
+	int pure = 0;
+	struct ExprProgram *body = compile_expr(ctx, &pure);
+
+	// recursive calls have been assumed to be pure, compile again if the body is not
+	if(body && !body->error && !pure)
+	{
+		free_program(body);
+
+		ctx->input_idx = 0;
+		next_lookahead(ctx);
+		match_head(ctx, def);
+
+		def->assume_pure = 0;
+		def->calls_user = 0;
+		body = compile_expr(ctx, &pure);
+	}
+
+	ctx->def = 0;
+
+	if(body && !body->error && define_func(ctx, def, body, pure))
+	{
+		struct ExprProgram *prog = create_program(&ctx->alloc);
+		if(prog)
+		{
+			emit_value(prog, 0);
+			emit_op(prog, OP_END);
 		}
+		return prog;
 	}
 
-	printf("Invalid lookahead in %s: \"%d\".\n", __func__, ctx->lookahead);
-	return 0.;
+	if(is_new)
+		free_user_func(func);
+
+	// return the body with its error, if there is one
+	if(body && !body->error)
+	{
+		free_program(body);
+		body = 0;
+	}
+	return body;
 }
 
-// ------------------------------------------------------------------------
 
+/**
+ * compiled programs might refer to replaced functions or constants:
+ * the cached ones are dropped, the formulas of variables compiled again
+ */
+void invalidate_programs(struct ParserContext* ctx)
+{
+	clear_cache(ctx->cache);
+	if(ctx->deps)
+		ctx->deps->stale = 1;
+}
+
+
+/**
+ * compile an expression or a function definition
+ * @param tokens the already lexed input or 0
+ */
+static struct ExprProgram* compile_input(struct ParserContext* ctx,
+	const char* str, const struct LexToken* tokens)
+{
+	refresh_env(ctx);
+	set_input(ctx, str, tokens);
+	next_lookahead(ctx);
+
+	struct FuncDef def;
+	struct ExprProgram *prog = match_definition(ctx, &def)
+		? compile_definition(ctx, &def)
+		: compile_expr(ctx, 0);
 
+	ctx->tokens = 0;
+	return prog;
+}
 
-// ----------------------------------------------------------------------------
-// parser interface
-// ----------------------------------------------------------------------------
 
-void init_parser(struct ParserContext* ctx)
+struct ExprProgram* compile(struct ParserContext* ctx, const char* str)
 {
-	ctx->lookahead = TOK_INVALID;
-	ctx->lookahead_val = 0;
-	ctx->lookahead_text[0] = 0;
+	return compile_input(ctx, str, 0);
+}
 
-	ctx->input_idx = 0;
-	ctx->input_len = 0;
-	ctx->input = 0;
 
-	my_strncpy(ctx->symboltable.name, "", MAX_IDENT);
-	ctx->symboltable.value = 0;
+/**
+ * compile the formulas of variables again after invalidate_programs() and recompute them,
+ * a formula which does not compile anymore leaves its variable's value
+ */
+static void refresh_formulas(struct ParserContext* ctx)
+{
+	struct DepGraph *graph = ctx->deps;
+	if(!graph || !graph->stale)
+		return;
+	graph->stale = 0;
+
+	for(u32 idx=0; idx<graph->num_nodes; ++idx)
+	{
+		struct DepNode *node = graph->nodes + idx;
+		if(!node->formula)
+			continue;
+
+		// the source is kept while the formula is replaced
+		char *text = node->text;
+		node->text = 0;
+		dep_drop_formula(ctx, idx);
+
+		struct ExprProgram *prog = compile_input(ctx, text, 0);
+		if(prog && !prog->error)
+		{
+			jit_program(ctx, prog);
+			dep_record_formula(ctx, prog, text);
+		}
+
+		free_program(prog);
+		expr_free(graph->alloc, text);
+	}
+
+	update_all(ctx);
+}
+
+
+/**
+ * evaluate an expression, compiling it only if it is not yet in the cache
+ * @param tokens the already lexed expression or 0
+ * @return EXPR_OK or the code of the first error, which is also kept in the diagnostics
+ */
+static int eval_input(struct ParserContext* ctx, const char* str,
+	const struct LexToken* tokens, t_value* val)
+{
+	*val = 0;
+
+	// a new snapshot of the shared environment clears the cache
+	refresh_env(ctx);
+	refresh_formulas(ctx);
+
+	u32 diags_before = ctx->diags.count;
+
+	struct ExprProgram *prog = cache_lookup(ctx->cache, str);
+	if(!prog)
+	{
+		prog = compile_input(ctx, str, tokens);
+		if(!prog)
+			return EXPR_ERR_MEMORY;
+
+		// only keep programs without errors
+		if(prog->error)
+		{
+			int err = prog->error;
+			free_program(prog);
+			return err;
+		}
+
+		// compile programs which are kept to native code, if enabled
+		jit_program(ctx, prog);
+		cache_insert(ctx->cache, str, prog);
+	}
+
+	*val = run_program(ctx, prog);
+
+	// an assignment's program becomes the formula of its variable
+	if(ctx->diags.count == diags_before)
+		dep_record_formula(ctx, prog, str);
+	update_dependents(ctx);
+
+	// run-time error
+	if(ctx->diags.count != diags_before)
+	{
+		*val = 0;
+		return ctx->diags.entries[diags_before % EXPR_MAX_DIAGS].code;
+	}
 
-	struct Symbol *sym = create_symbol("pi", M_PI);
-	ctx->symboltable.next = sym;
+	return EXPR_OK;
 }
 
 
-void deinit_parser(struct ParserContext* ctx)
+int try_parse(struct ParserContext* ctx, const char* str, t_value* val)
 {
-	struct Symbol *sym = ctx->symboltable.next;
+	return eval_input(ctx, str, 0, val);
+}
+
 
-	while(sym)
+/**
+ * evaluate a line whose tokens are already known
+ */
+int try_parse_line(struct ParserContext* ctx, struct ExprLine* line, t_value* val)
+{
+	// terminate the token list, leaving the line unchanged for further editing:
+	// the copy only appends tokens behind the line's ones
+	struct ExprLine rest = *line;
+	while(rest.state != LS_START)
 	{
-		struct Symbol *symnext = sym->next;
-		free(sym);
-		sym = symnext;
+		int tok_end = line_token(&rest, rest.len, rest.toks + rest.num_toks++);
+		rest.state = LS_START;
+
+		for(int idx=tok_end; idx<rest.len; ++idx)
+			line_lex_char(&rest, idx);
 	}
 
-	ctx->symboltable.next = 0;
+	struct LexToken *end = rest.toks + rest.num_toks;
+	end->tok = TOK_END;
+	end->pos = line->len;
+	end->len = 0;
+	end->val = 0;
+
+	return eval_input(ctx, line->text, line->toks, val);
 }
 
 
+/**
+ * evaluate an expression, ignoring errors
+ */
 t_value parse(struct ParserContext* ctx, const char* str)
 {
-	set_input(ctx, str);
-	next_lookahead(ctx);
-	return plus_term(ctx);
+	t_value val = 0;
+	try_parse(ctx, str, &val);
+	return val;
 }
 // ----------------------------------------------------------------------------
 
 
-/* // test: gcc -Wall -Wextra -o 0 expr_parser.c string.c -lm
+/* // test: gcc -Wall -Wextra -o 0 expr_parser.c expr_ast.c expr_code.c expr_funcs.c expr_deps.c expr_env.c expr_jit.c expr_alloc.c expr_diag.c string.c -lm
 int main()
 {
 	struct ParserContext ctx;
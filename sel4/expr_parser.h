@@ -14,6 +14,13 @@
 #ifndef __EXPR_PARSER_H__
 #define __EXPR_PARSER_H__
 
+#include "string.h"
+#include "expr_alloc.h"
+#include "expr_diag.h"
+
+
+#define EXPR_MAX_OPS 64      // default capacity of the parser's operator and operand stacks
+
 
 //#define USE_INTEGER
 #ifdef USE_INTEGER
@@ -23,15 +30,87 @@
 #endif
 
 
-#define MAX_IDENT 256
-
-
 struct Symbol
 {
-	char name[MAX_IDENT];
+	u32 name;       // offset into the name arena
+	u32 name_len;
 	t_value value;
+	int has_value;  // the symbol has been assigned as a variable
+
+	struct UserFunc *func;  // function defined with this name, 0: none
+};
+
+
+struct SymbolSlot
+{
+	u32 hash;
+	u32 idx;        // 1-based index into the symbol array, 0: free slot
+};
+
+
+struct SymbolTable
+{
+	struct Symbol *syms;        // symbols in insertion order
+	u32 num_syms, syms_cap;
+
+	struct SymbolSlot *slots;   // open-addressing hash index, power-of-two size
+	u32 slots_cap;
+
+	char *names;                // arena of interned, '\0'-terminated names
+	u32 names_len, names_cap;
+
+	const struct ExprAllocator *alloc;
+};
+
+
+/**
+ * token which has already been lexed
+ */
+struct LexToken
+{
+	int tok;
+	int pos, len;               // span in the input
+	t_value val;
+};
+
+
+/**
+ * line which is lexed character by character while it is being typed
+ */
+struct ExprLine
+{
+	char *text;                 // '\0'-terminated
+	int len, cap;
+
+	struct LexToken *toks;      // completed tokens
+	int num_toks;
+
+	int state;                  // automaton state of the unfinished token
+	int tok_pos;                // start of the unfinished token
+};
+
 
-	struct Symbol* next;
+struct ExprProgram;
+struct ExprCache;
+struct FuncRegistry;
+struct AstBuilder;
+struct JitBuffer;
+struct UserFunc;
+struct CallStack;
+struct FuncDef;
+struct DepGraph;
+struct ExprTaskPool;
+struct SharedEnv;
+struct ExprEnv;
+
+
+/**
+ * console given by the embedder
+ */
+struct ExprConsole
+{
+	void (*write)(void* user, const char* str, u64 len);
+	void *user;
 };
 
 
@@ -39,21 +118,64 @@ struct ParserContext
 {
 	int lookahead;
 	t_value lookahead_val;
-	char lookahead_text[MAX_IDENT];
+	int lookahead_pos;          // span of the lookahead token in the input
+	int lookahead_len;
 
-	int input_idx;
+	int input_idx;              // position in the input or index of the next pre-lexed token
 	int input_len;
 	const char* input;
+	const struct LexToken *tokens; // pre-lexed input ending with TOK_END, 0: run the lexer
+	int max_ops;                // capacity of the parser's stacks
+
+	struct SymbolTable symboltable;
+	struct DiagRing diags;      // errors of the recent compilations and evaluations
 
-	struct Symbol symboltable;
+	struct ExprAllocator alloc; // long-lived data: symbols, programs, functions
+	struct Heap heap;           // state of the default allocator
+	struct Arena scratch;       // temporary data, reset after each compilation
+
+	struct ExprProgram *prog;   // program currently being compiled
+	struct AstBuilder *ast;     // syntax tree currently being built
+	struct ExprCache *cache;    // recently compiled programs
+	struct FuncRegistry *funcs; // functions registered by the embedder for this context
+	struct SharedEnv *shared_env; // constants and functions shared with other contexts, 0: none
+	struct ExprEnv *env;        // snapshot of the shared environment in use
+	struct JitBuffer *jit;      // executable memory for compiled programs, 0: interpret
+
+	struct FuncDef *def;        // function definition currently being compiled
+	struct CallStack *calls;    // frames of user-defined function calls, allocated on first use
+	u32 memo_size;              // results to memoise per pure user-defined function, 0: none
+
+	struct DepGraph *deps;      // formulas of the variables, allocated on first use
+	const struct ExprTaskPool *pool; // workers recomputing independent formulas, 0: none
+
+	const struct ExprConsole *console; // output of print_symbols() and print_diagnostics(), 0: stdout
 };
 
 
-extern void init_parser(struct ParserContext*);
+extern int init_parser(struct ParserContext*);
+extern int init_parser_mem(struct ParserContext*, void* mem, u64 size);
+extern int init_parser_alloc(struct ParserContext*, const struct ExprAllocator* alloc);
 extern void deinit_parser(struct ParserContext*);
 
+extern struct ExprProgram* compile(struct ParserContext*, const char* str);
+extern void invalidate_programs(struct ParserContext*);
+extern int try_parse(struct ParserContext*, const char* str, t_value* val);
 extern t_value parse(struct ParserContext*, const char* str);
+
+extern int init_line(struct ParserContext*, struct ExprLine* line, int cap);
+extern void deinit_line(struct ParserContext*, struct ExprLine* line);
+extern void clear_line(struct ExprLine* line);
+extern int line_insert(struct ExprLine* line, char c);
+extern int line_erase(struct ExprLine* line);
+extern int try_parse_line(struct ParserContext*, struct ExprLine* line, t_value* val);
+
+extern struct Symbol* find_symbol(struct ParserContext*, const char* name);
+extern struct Symbol* assign_or_insert_symbol(struct ParserContext*, const char* name, t_value value);
+extern const char* symbol_name(const struct ParserContext*, const struct Symbol* sym);
+extern struct UserFunc* find_user_func(struct ParserContext*, const char* name, int len);
 extern void print_symbols(struct ParserContext*);
+extern void print_message(const struct ParserContext*, const char* str, u64 len);
 
 
 #endif
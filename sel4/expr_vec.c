@@ -0,0 +1,380 @@
+/**
+ * evaluation of compiled expressions over arrays of variable values
+ *
+ * @author agent
+ * @date 16-oct-2026
+ * @license GPLv3, see 'LICENSE' file
+ *
+ * References:
+ *	- https://www.intel.com/content/www/us/en/docs/intrinsics-guide/index.html
+ */
+
+#include <stdlib.h>
+#include <math.h>
+
+#if !defined(USE_INTEGER) && (defined(__AVX2__) || defined(__SSE2__))
+	#include <immintrin.h>
+#endif
+
+#include "expr_vec.h"
+
+
+// ----------------------------------------------------------------------------
+// kernels working on blocks of values
+// ----------------------------------------------------------------------------
+
+#if !defined(USE_INTEGER) && defined(__AVX2__)
+	#define VEC_WIDTH 4
+	#define vec_t     __m256d
+	#define vec_load  _mm256_loadu_pd
+	#define vec_store _mm256_storeu_pd
+	#define vec_add   _mm256_add_pd
+	#define vec_sub   _mm256_sub_pd
+	#define vec_mul   _mm256_mul_pd
+	#define vec_div   _mm256_div_pd
+	#define vec_sqrt  _mm256_sqrt_pd
+	#define vec_xor   _mm256_xor_pd
+	#define vec_set1  _mm256_set1_pd
+#elif !defined(USE_INTEGER) && defined(__SSE2__)
+	#define VEC_WIDTH 2
+	#define vec_t     __m128d
+	#define vec_load  _mm_loadu_pd
+	#define vec_store _mm_storeu_pd
+	#define vec_add   _mm_add_pd
+	#define vec_sub   _mm_sub_pd
+	#define vec_mul   _mm_mul_pd
+	#define vec_div   _mm_div_pd
+	#define vec_sqrt  _mm_sqrt_pd
+	#define vec_xor   _mm_xor_pd
+	#define vec_set1  _mm_set1_pd
+#else
+	#define VEC_WIDTH 1
+#endif
+
+
+#if VEC_WIDTH > 1
+	#define DEF_KERNEL2(name, op, vec_op) \
+	static void kernel_##name(t_value* out, const t_value* a, const t_value* b, int n) \
+	{ \
+		int i = 0; \
+		for(; i+VEC_WIDTH <= n; i += VEC_WIDTH) \
+			vec_store(out+i, vec_op(vec_load(a+i), vec_load(b+i))); \
+		for(; i<n; ++i) \
+			out[i] = a[i] op b[i]; \
+	}
+#else
+	#define DEF_KERNEL2(name, op, vec_op) \
+	static void kernel_##name(t_value* out, const t_value* a, const t_value* b, int n) \
+	{ \
+		for(int i=0; i<n; ++i) \
+			out[i] = a[i] op b[i]; \
+	}
+#endif
+
+DEF_KERNEL2(add, +, vec_add)
+DEF_KERNEL2(sub, -, vec_sub)
+DEF_KERNEL2(mul, *, vec_mul)
+DEF_KERNEL2(div, /, vec_div)
+
+
+static void kernel_neg(t_value* out, const t_value* a, int n)
+{
+	int i = 0;
+#if VEC_WIDTH > 1
+	const vec_t sign = vec_set1(-0.);
+	for(; i+VEC_WIDTH <= n; i += VEC_WIDTH)
+		vec_store(out+i, vec_xor(vec_load(a+i), sign));
+#endif
+	for(; i<n; ++i)
+		out[i] = -a[i];
+}
+
+
+static void kernel_sqrt(t_value* out, const t_value* a, int n)
+{
+	int i = 0;
+#if VEC_WIDTH > 1
+	for(; i+VEC_WIDTH <= n; i += VEC_WIDTH)
+		vec_store(out+i, vec_sqrt(vec_load(a+i)));
+#endif
+	for(; i<n; ++i)
+		out[i] = (t_value)sqrt(a[i]);
+}
+
+
+static void kernel_fill(t_value* out, t_value val, int n)
+{
+	for(int i=0; i<n; ++i)
+		out[i] = val;
+}
+// ----------------------------------------------------------------------------
+
+
+
+// ----------------------------------------------------------------------------
+// batch evaluation
+// ----------------------------------------------------------------------------
+
+/**
+ * find the column bound to a variable name
+ */
+static int find_column(const char** col_names, int num_cols, const char* name)
+{
+	for(int col=0; col<num_cols; ++col)
+	{
+		if(my_strcmp(col_names[col], name) == 0)
+			return col;
+	}
+
+	return -1;
+}
+
+
+/**
+ * evaluate a program for num_rows rows of variable values
+ *
+ * variables which are not bound to a column are taken from the symbol table,
+ * programs containing assignments or conditionals are rejected
+ *
+ * @return 1 on success
+ */
+int eval_batch(struct ParserContext* ctx, const struct ExprProgram* prog,
+	const char** col_names, const t_value** cols, int num_cols,
+	t_value* out, u64 num_rows)
+{
+	if(!prog || prog->error)
+		return 0;
+
+	// the buffers are temporary data, released at once at the end
+	struct Arena *arena = &ctx->scratch;
+
+	// resolve the variables once for all rows
+	int *var_cols = (int*)arena_alloc(arena, prog->code_len * sizeof(int));
+	t_value *var_vals = (t_value*)arena_alloc(arena, prog->code_len * sizeof(t_value));
+	int max_stack = prog->max_stack ? prog->max_stack : 1;
+	t_value *bufs = (t_value*)arena_alloc(arena, max_stack * EXPR_BLOCK_SIZE * sizeof(t_value));
+	int num_temps = prog->num_temps ? prog->num_temps : 1;
+	t_value *temps = (t_value*)arena_alloc(arena, num_temps * EXPR_BLOCK_SIZE * sizeof(t_value));
+	if(!var_cols || !var_vals || !bufs || !temps)
+	{
+		arena_reset(arena);
+		return 0;
+	}
+
+	int ok = 1;
+	for(int ip=0; ip<prog->code_len; ++ip)
+	{
+		const struct ExprInstr *instr = prog->code + ip;
+		if(instr->op == OP_STORE)
+		{
+			report_error(ctx, EXPR_ERR_BATCH_ASSIGN, -1, 0, 0, 0);
+			ok = 0;
+			break;
+		}
+		if(instr->op == OP_JZ || instr->op == OP_JMP)
+		{
+			report_error(ctx, EXPR_ERR_BATCH_BRANCH, -1, 0, 0, 0);
+			ok = 0;
+			break;
+		}
+		if(instr->op != OP_LOAD)
+			continue;
+
+		const char *name = prog->names + instr->arg.name;
+		var_cols[ip] = find_column(col_names, num_cols, name);
+		if(var_cols[ip] >= 0)
+			continue;
+
+		const struct Symbol *sym = find_symbol(ctx, name);
+		if(!sym)
+		{
+			report_error(ctx, EXPR_ERR_UNKNOWN_IDENT, -1, 0, name, my_strlen(name));
+			ok = 0;
+			break;
+		}
+		var_vals[ip] = sym->value;
+	}
+
+	// every stack level owns a block buffer, but may also point directly into a column
+	const t_value *stack[EXPR_MAX_STACK];
+	#define BLOCK_BUF(level) (bufs + (level)*EXPR_BLOCK_SIZE)
+
+	// the square root has a vectorised kernel
+	t_func1 func_sqrt = get_builtin_func1("sqrt");
+
+	for(u64 row=0; ok && row<num_rows; row += EXPR_BLOCK_SIZE)
+	{
+		int n = num_rows - row < EXPR_BLOCK_SIZE ? (int)(num_rows - row) : EXPR_BLOCK_SIZE;
+		int sp = 0;
+
+		for(int ip=0; ip<prog->code_len; ++ip)
+		{
+			const struct ExprInstr *instr = prog->code + ip;
+
+			switch(instr->op)
+			{
+				case OP_END:
+					if(sp)
+						my_memcpy((i8*)(out + row), (i8*)stack[sp-1], n*sizeof(t_value));
+					else
+						kernel_fill(out + row, 0, n);
+					break;
+
+				case OP_PUSH:
+					kernel_fill(BLOCK_BUF(sp), instr->arg.val, n);
+					stack[sp] = BLOCK_BUF(sp);
+					++sp;
+					break;
+
+				case OP_LOAD:
+					if(var_cols[ip] >= 0)
+					{
+						stack[sp++] = cols[var_cols[ip]] + row;
+					}
+					else
+					{
+						kernel_fill(BLOCK_BUF(sp), var_vals[ip], n);
+						stack[sp] = BLOCK_BUF(sp);
+						++sp;
+					}
+					break;
+
+				case OP_ADD:
+					kernel_add(BLOCK_BUF(sp-2), stack[sp-2], stack[sp-1], n);
+					stack[sp-2] = BLOCK_BUF(sp-2);
+					--sp;
+					break;
+
+				case OP_SUB:
+					kernel_sub(BLOCK_BUF(sp-2), stack[sp-2], stack[sp-1], n);
+					stack[sp-2] = BLOCK_BUF(sp-2);
+					--sp;
+					break;
+
+				case OP_MUL:
+					kernel_mul(BLOCK_BUF(sp-2), stack[sp-2], stack[sp-1], n);
+					stack[sp-2] = BLOCK_BUF(sp-2);
+					--sp;
+					break;
+
+				case OP_DIV:
+					kernel_div(BLOCK_BUF(sp-2), stack[sp-2], stack[sp-1], n);
+					stack[sp-2] = BLOCK_BUF(sp-2);
+					--sp;
+					break;
+
+				case OP_MOD:
+					for(int i=0; i<n; ++i)
+						BLOCK_BUF(sp-2)[i] = fmod(stack[sp-2][i], stack[sp-1][i]);
+					stack[sp-2] = BLOCK_BUF(sp-2);
+					--sp;
+					break;
+
+				case OP_POW:
+					for(int i=0; i<n; ++i)
+						BLOCK_BUF(sp-2)[i] = pow(stack[sp-2][i], stack[sp-1][i]);
+					stack[sp-2] = BLOCK_BUF(sp-2);
+					--sp;
+					break;
+
+				case OP_NEG:
+					kernel_neg(BLOCK_BUF(sp-1), stack[sp-1], n);
+					stack[sp-1] = BLOCK_BUF(sp-1);
+					break;
+
+				case OP_CALL0:
+					for(int i=0; i<n; ++i)
+						BLOCK_BUF(sp)[i] = (*instr->arg.func.f0)();
+					stack[sp] = BLOCK_BUF(sp);
+					++sp;
+					break;
+
+				case OP_CALL1:
+				{
+					t_func1 func = instr->arg.func.f1;
+					if(func == func_sqrt)
+					{
+						kernel_sqrt(BLOCK_BUF(sp-1), stack[sp-1], n);
+					}
+					else
+					{
+						for(int i=0; i<n; ++i)
+							BLOCK_BUF(sp-1)[i] = (*func)(stack[sp-1][i]);
+					}
+					stack[sp-1] = BLOCK_BUF(sp-1);
+					break;
+				}
+
+				case OP_CALL2:
+					for(int i=0; i<n; ++i)
+						BLOCK_BUF(sp-2)[i] = (*instr->arg.func.f2)(stack[sp-2][i], stack[sp-1][i]);
+					stack[sp-2] = BLOCK_BUF(sp-2);
+					--sp;
+					break;
+
+				case OP_CALLN:
+				{
+					int num_args = instr->num_args;
+					t_value *buf_first = BLOCK_BUF(sp-num_args);
+					t_value args[EXPR_MAX_STACK];
+
+					for(int i=0; i<n; ++i)
+					{
+						for(int arg=0; arg<num_args; ++arg)
+							args[arg] = stack[sp-num_args+arg][i];
+						// the first argument's buffer is only overwritten after it has been read
+						buf_first[i] = (*instr->arg.func.fn)(args, num_args);
+					}
+
+					sp -= num_args;
+					stack[sp++] = buf_first;
+					break;
+				}
+
+				case OP_CALLU:
+				{
+					// user-defined functions are evaluated row by row
+					int num_args = instr->num_args;
+					t_value *buf_first = BLOCK_BUF(sp-num_args);
+					t_value args[FUNC_MAX_PARAMS];
+					u32 diags_before = ctx->diags.count;
+
+					for(int i=0; i<n && ok; ++i)
+					{
+						for(int arg=0; arg<num_args; ++arg)
+							args[arg] = stack[sp-num_args+arg][i];
+						buf_first[i] = call_user_func(ctx, instr->arg.ufunc, args, num_args);
+						ok = ctx->diags.count == diags_before;
+					}
+
+					sp -= num_args;
+					stack[sp++] = buf_first;
+					break;
+				}
+
+				case OP_TSTORE:
+					my_memcpy((i8*)(temps + instr->arg.temp*EXPR_BLOCK_SIZE),
+						(i8*)stack[sp-1], n*sizeof(t_value));
+					break;
+
+				case OP_TLOAD:
+					stack[sp++] = temps + instr->arg.temp*EXPR_BLOCK_SIZE;
+					break;
+
+				default:
+					report_error(ctx, EXPR_ERR_INTERNAL, -1, 0, 0, 0);
+					ok = 0;
+					break;
+			}
+
+			if(!ok)
+				break;
+		}
+	}
+
+	#undef BLOCK_BUF
+
+	arena_reset(arena);
+	return ok;
+}
+// ----------------------------------------------------------------------------
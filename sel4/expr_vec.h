@@ -0,0 +1,24 @@
+/**
+ * evaluation of compiled expressions over arrays of variable values
+ *
+ * @author agent
+ * @date 16-oct-2026
+ * @license GPLv3, see 'LICENSE' file
+ */
+
+#ifndef __EXPR_VEC_H__
+#define __EXPR_VEC_H__
+
+#include "expr_parser.h"
+#include "expr_code.h"
+
+
+#define EXPR_BLOCK_SIZE 64      // number of rows evaluated together
+
+
+extern int eval_batch(struct ParserContext* ctx, const struct ExprProgram* prog,
+	const char** col_names, const t_value** cols, int num_cols,
+	t_value* out, u64 num_rows);
+
+
+#endif
@@ -0,0 +1,458 @@
+/**
+ * text screen output
+ *
+ * all output goes to a copy of the screen in normal memory, which records the
+ * changed span of each row; flushing writes only these spans to the uncached
+ * video memory, in aligned words of four cells, and never reads it back
+ *
+ * the screen is a window into the larger text memory; scrolling moves the
+ * window down by reprogramming the crt controller's start address, so that
+ * only the new rows have to be written, and once the window reaches the end
+ * of the text memory, it starts again at the top with a redraw of the screen;
+ * the cursor is the controller's as well and is moved once per flush
+ *
+ * rows which are scrolled off the screen can be kept in a compressed history,
+ * through which the screen's scrolled region can be paged
+ *
+ * @author agent
+ * @date 16-oct-2026
+ * @license GPLv3, see 'LICENSE' file
+ *
+ * References:
+ *   - https://wiki.osdev.org/Printing_To_Screen
+ *   - https://jbwyatt.com/253/emu/memory.html
+ *   - http://www.osdever.net/FreeVGA/vga/crtcreg.htm
+ */
+
+#include "screen.h"
+#include "string.h"
+
+
+#define CELLS_PER_WORD 4    // cells written to video memory at once
+
+typedef u64 __attribute__((__may_alias__)) t_cells;
+
+
+static inline u16 make_cell(i8 ch, u8 attr)
+{
+	return (u16)(u8)ch | ((u16)attr << 8);
+}
+
+
+static inline void mark_dirty(struct Screen* scr, i32 y, i32 x_begin, i32 x_end)
+{
+	if(scr->dirty_begin[y] > x_begin)
+		scr->dirty_begin[y] = (u8)x_begin;
+	if(scr->dirty_end[y] < x_end)
+		scr->dirty_end[y] = (u8)x_end;
+}
+
+
+static void fill_cells(u16* cells, u16 cell, u32 num)
+{
+	for(u32 i=0; i<num; ++i)
+		cells[i] = cell;
+}
+
+
+// ----------------------------------------------------------------------------
+// history
+// a row is stored as runs of cells with the same attribute, each starting
+// with a header byte giving the run's length and whether it repeats one
+// character or lists its characters, followed by the attribute
+// ----------------------------------------------------------------------------
+
+#define RUN_REPEAT     0x80                 // header flag: one character for the whole run
+#define RUN_MIN_REPEAT 3                    // shorter repetitions are listed
+#define ROW_MAX_BYTES  (SCREEN_COL_SIZE*3)  // at worst one run per cell
+
+
+static u32 encode_row(const u16* cells, u8* out)
+{
+	u32 len = 0;
+
+	for(u32 x=0; x<SCREEN_COL_SIZE; )
+	{
+		u8 attr = (u8)(cells[x] >> 8);
+
+		u32 repeat = 1;
+		while(x + repeat < SCREEN_COL_SIZE && cells[x + repeat] == cells[x])
+			++repeat;
+
+		if(repeat >= RUN_MIN_REPEAT)
+		{
+			out[len++] = RUN_REPEAT | (u8)repeat;
+			out[len++] = attr;
+			out[len++] = (u8)cells[x];
+			x += repeat;
+			continue;
+		}
+
+		// list the characters up to the next attribute change or repetition
+		u32 end = x + 1;
+		for(; end < SCREEN_COL_SIZE && (cells[end] >> 8) == attr; ++end)
+		{
+			if(end + RUN_MIN_REPEAT <= SCREEN_COL_SIZE
+				&& cells[end] == cells[end + 1] && cells[end] == cells[end + 2])
+				break;
+		}
+
+		out[len++] = (u8)(end - x);
+		out[len++] = attr;
+		for(; x < end; ++x)
+			out[len++] = (u8)cells[x];
+	}
+
+	return len;
+}
+
+
+static void decode_row(const struct History* hist, u32 row, u16* cells)
+{
+	u32 pos = hist->row_pos[row & (HISTORY_ROWS - 1)];
+	for(u32 x=0; x<SCREEN_COL_SIZE; )
+	{
+		u8 header = hist->data[pos++ & (HISTORY_BYTES - 1)];
+		u16 attr = (u16)hist->data[pos++ & (HISTORY_BYTES - 1)] << 8;
+		u32 len = header & ~RUN_REPEAT;
+
+		if(header & RUN_REPEAT)
+		{
+			u16 cell = attr | hist->data[pos++ & (HISTORY_BYTES - 1)];
+			for(u32 i=0; i<len; ++i)
+				cells[x++] = cell;
+		}
+		else
+		{
+			for(u32 i=0; i<len; ++i)
+				cells[x++] = attr | hist->data[pos++ & (HISTORY_BYTES - 1)];
+		}
+	}
+}
+
+
+static void history_push(struct History* hist, const u16* cells)
+{
+	u8 row[ROW_MAX_BYTES];
+	u32 len = encode_row(cells, row);
+
+	// drop the oldest rows to make room
+	while(hist->end_row - hist->first_row >= HISTORY_ROWS
+		|| hist->head - hist->row_pos[hist->first_row & (HISTORY_ROWS - 1)] + len > HISTORY_BYTES)
+	{
+		if(hist->first_row == hist->end_row)
+			break;
+		++hist->first_row;
+	}
+
+	hist->row_pos[hist->end_row++ & (HISTORY_ROWS - 1)] = hist->head;
+	for(u32 i=0; i<len; ++i)
+		hist->data[hist->head++ & (HISTORY_BYTES - 1)] = row[i];
+}
+
+
+/**
+ * remove the newest rows
+ */
+static void history_pop(struct History* hist, u32 num)
+{
+	hist->end_row -= num;
+	hist->head = hist->row_pos[hist->end_row & (HISTORY_ROWS - 1)];
+}
+// ----------------------------------------------------------------------------
+
+
+
+// ----------------------------------------------------------------------------
+// screen
+// ----------------------------------------------------------------------------
+
+static void mark_rows_dirty(struct Screen* scr, i32 y_begin, i32 y_end)
+{
+	for(i32 y=y_begin; y<y_end; ++y)
+		mark_dirty(scr, y, 0, SCREEN_COL_SIZE);
+}
+
+
+/**
+ * put the rows into the history, if there is one
+ */
+static void keep_rows(struct Screen* scr, i32 y_begin, i32 y_end)
+{
+	if(!scr->history)
+		return;
+
+	for(i32 y=y_begin; y<y_end; ++y)
+		history_push(scr->history, scr->cells + y*SCREEN_COL_SIZE);
+}
+
+
+static void set_crtc(seL4_CPtr port, u8 reg, u8 val)
+{
+	seL4_X86_IOPort_Out8(port, CRTC_ADDR_PORT, reg);
+	seL4_X86_IOPort_Out8(port, CRTC_DATA_PORT, val);
+}
+
+
+/**
+ * @param vram text window of CHAROUT_PAGES pages, the screen is cleared with the given attribute
+ * @param crtc_port capability for the crt controller's ports, 0: no hardware scrolling
+ */
+void screen_init(struct Screen* scr, i8* vram, seL4_CPtr crtc_port, u8 attr)
+{
+	scr->vram = (volatile u16*)vram;
+	scr->crtc_port = crtc_port;
+	scr->origin = 0;
+	scr->shown_origin = ~0u;    // program it with the first flush
+
+	scr->history = 0;
+
+	scr->cursor_x = scr->cursor_y = 0;
+	scr->shown_cursor = ~0u;
+	if(crtc_port)
+	{
+		// underline cursor
+		set_crtc(crtc_port, CRTC_CURSOR_BEGIN, 14);
+		set_crtc(crtc_port, CRTC_CURSOR_END, 15);
+	}
+
+	for(i32 y=0; y<SCREEN_ROW_SIZE; ++y)
+	{
+		scr->dirty_begin[y] = SCREEN_COL_SIZE;
+		scr->dirty_end[y] = 0;
+	}
+
+	screen_clear(scr, 0, SCREEN_ROW_SIZE, attr);
+}
+
+
+void screen_put(struct Screen* scr, i32 x, i32 y, i8 ch, u8 attr)
+{
+	if(x < 0 || x >= SCREEN_COL_SIZE || y < 0 || y >= SCREEN_ROW_SIZE)
+		return;
+
+	u16 cell = make_cell(ch, attr);
+	u16 *pos = scr->cells + y*SCREEN_COL_SIZE + x;
+	if(*pos == cell)
+		return;
+
+	*pos = cell;
+	mark_dirty(scr, y, x, x + 1);
+}
+
+
+/**
+ * write a string, which is clipped at the end of the row
+ */
+void screen_write(struct Screen* scr, i32 x, i32 y, const i8* str, u8 attr)
+{
+	if(x < 0 || y < 0 || y >= SCREEN_ROW_SIZE)
+		return;
+
+	u16 *row = scr->cells + y*SCREEN_COL_SIZE;
+	i32 x_begin = x;
+	for(; x < SCREEN_COL_SIZE && *str; ++x, ++str)
+		row[x] = make_cell(*str, attr);
+
+	if(x > x_begin)
+		mark_dirty(scr, y, x_begin, x);
+}
+
+
+/**
+ * change the attribute of a cell, e.g. to show the cursor
+ */
+void screen_set_attr(struct Screen* scr, i32 x, i32 y, u8 attr)
+{
+	if(x < 0 || x >= SCREEN_COL_SIZE || y < 0 || y >= SCREEN_ROW_SIZE)
+		return;
+
+	u16 *pos = scr->cells + y*SCREEN_COL_SIZE + x;
+	screen_put(scr, x, y, (i8)(*pos & 0xff), attr);
+}
+
+
+/**
+ * the cursor is only shown with the crt controller
+ */
+void screen_set_cursor(struct Screen* scr, i32 x, i32 y)
+{
+	scr->cursor_x = x;
+	scr->cursor_y = y;
+}
+
+
+/**
+ * clear the rows [y_begin, y_end[
+ */
+void screen_clear(struct Screen* scr, i32 y_begin, i32 y_end, u8 attr)
+{
+	fill_cells(scr->cells + y_begin*SCREEN_COL_SIZE, make_cell(0, attr),
+		(u32)(y_end - y_begin)*SCREEN_COL_SIZE);
+
+	mark_rows_dirty(scr, y_begin, y_end);
+}
+
+
+/**
+ * move the rows [y_begin + lines, y_end[ up to y_begin and clear the freed rows at the bottom
+ */
+void screen_scroll(struct Screen* scr, i32 y_begin, i32 y_end, i32 lines, u8 attr)
+{
+	if(lines >= y_end - y_begin)
+	{
+		keep_rows(scr, y_begin, y_end);
+		screen_clear(scr, y_begin, y_end, attr);
+		return;
+	}
+
+	keep_rows(scr, y_begin, y_begin + lines);
+
+	// the rows are moved in normal memory, the video memory is only written
+	my_memcpy((i8*)(scr->cells + y_begin*SCREEN_COL_SIZE),
+		(i8*)(scr->cells + (y_begin + lines)*SCREEN_COL_SIZE),
+		(u64)(y_end - y_begin - lines)*SCREEN_COL_SIZE*sizeof(u16));
+
+	if(!scr->crtc_port)
+	{
+		mark_rows_dirty(scr, y_begin, y_end - lines);
+	}
+	else
+	{
+		// move the window instead, the moved rows are already in video memory
+		// and only take their unflushed changes along
+		scr->origin += (u32)lines;
+		for(i32 y=y_begin; y<y_end-lines; ++y)
+		{
+			scr->dirty_begin[y] = scr->dirty_begin[y + lines];
+			scr->dirty_end[y] = scr->dirty_end[y + lines];
+		}
+
+		// rows outside of the scrolled region have to stay in place
+		mark_rows_dirty(scr, 0, y_begin);
+		mark_rows_dirty(scr, y_end, SCREEN_ROW_SIZE);
+
+		// wrap around to the top of the text window, redrawing the whole screen at once
+		if(scr->origin + SCREEN_ROW_SIZE > VRAM_ROWS)
+		{
+			scr->origin = 0;
+			mark_rows_dirty(scr, 0, SCREEN_ROW_SIZE);
+		}
+	}
+
+	screen_clear(scr, y_end - lines, y_end, attr);
+}
+
+
+/**
+ * write the changed cells to video memory
+ */
+void screen_flush(struct Screen* scr)
+{
+	for(i32 y=0; y<SCREEN_ROW_SIZE; ++y)
+	{
+		i32 x_begin = scr->dirty_begin[y];
+		i32 x_end = scr->dirty_end[y];
+		if(x_begin >= x_end)
+			continue;
+
+		// widen the span to whole words, rows start at word boundaries
+		x_begin &= ~(CELLS_PER_WORD - 1);
+		x_end = (x_end + CELLS_PER_WORD - 1) & ~(CELLS_PER_WORD - 1);
+
+		const t_cells *src = (const t_cells*)(scr->cells + y*SCREEN_COL_SIZE + x_begin);
+		volatile t_cells *dst = (volatile t_cells*)(scr->vram
+			+ (scr->origin + y)*SCREEN_COL_SIZE + x_begin);
+		for(i32 x=x_begin; x<x_end; x+=CELLS_PER_WORD)
+			*dst++ = *src++;
+
+		scr->dirty_begin[y] = SCREEN_COL_SIZE;
+		scr->dirty_end[y] = 0;
+	}
+
+	if(!scr->crtc_port)
+		return;
+
+	// show the window only once its rows are written
+	if(scr->origin != scr->shown_origin)
+	{
+		u32 start = scr->origin * SCREEN_COL_SIZE;
+		set_crtc(scr->crtc_port, CRTC_START_HI, (u8)(start >> 8));
+		set_crtc(scr->crtc_port, CRTC_START_LO, (u8)(start & 0xff));
+		scr->shown_origin = scr->origin;
+	}
+
+	// the cursor address is in the text window, not on the screen
+	u32 cursor = (scr->origin + (u32)scr->cursor_y)*SCREEN_COL_SIZE + (u32)scr->cursor_x;
+	if(cursor != scr->shown_cursor)
+	{
+		set_crtc(scr->crtc_port, CRTC_CURSOR_HI, (u8)(cursor >> 8));
+		set_crtc(scr->crtc_port, CRTC_CURSOR_LO, (u8)(cursor & 0xff));
+		scr->shown_cursor = cursor;
+	}
+}
+
+
+void screen_set_history(struct Screen* scr, struct History* history)
+{
+	if(history)
+	{
+		history->head = 0;
+		history->first_row = history->end_row = 0;
+		history->view = 0;
+		history->saved_rows = 0;
+	}
+
+	scr->history = history;
+}
+
+
+/**
+ * show older (lines > 0) or newer (lines < 0) rows of the history in the scrolled region,
+ * paging back below the newest row shows the screen again
+ */
+void screen_page(struct Screen* scr, i32 y_begin, i32 y_end, i32 lines)
+{
+	struct History *hist = scr->history;
+	if(!hist || (!hist->view && lines <= 0))
+		return;
+
+	i32 rows = y_end - y_begin;
+
+	// keep the screen's rows in the history while paging
+	if(!hist->view)
+	{
+		keep_rows(scr, y_begin, y_end);
+		hist->saved_rows = rows;
+	}
+
+	i32 max_view = (i32)(hist->end_row - hist->first_row) - rows;
+	i32 view = hist->view + lines;
+	if(view > max_view)
+		view = max_view;
+	if(view < 0)
+		view = 0;
+	hist->view = view;
+
+	// redraw the region, showing the rows [end_row - rows - view, end_row - view[
+	u32 top = hist->end_row - (u32)rows - (u32)view;
+	for(i32 y=y_begin; y<y_end; ++y)
+	{
+		u32 row = top + (u32)(y - y_begin);
+		u16 *cells = scr->cells + y*SCREEN_COL_SIZE;
+
+		if((i32)(row - hist->first_row) < 0)
+			fill_cells(cells, 0, SCREEN_COL_SIZE);
+		else
+			decode_row(hist, row, cells);
+		mark_rows_dirty(scr, y, y + 1);
+	}
+
+	// back on the screen, whose rows have just been restored
+	if(!view)
+	{
+		history_pop(hist, (u32)hist->saved_rows);
+		hist->saved_rows = 0;
+	}
+}
+// ----------------------------------------------------------------------------
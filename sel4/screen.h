@@ -0,0 +1,79 @@
+/**
+ * text screen output
+ * @author agent
+ * @date 16-oct-2026
+ * @license GPLv3, see 'LICENSE' file
+ *
+ * References:
+ *   - https://wiki.osdev.org/Printing_To_Screen
+ *   - https://jbwyatt.com/253/emu/memory.html
+ */
+
+#ifndef __SCREEN_H__
+#define __SCREEN_H__
+
+#include "defines.h"
+
+
+#define VRAM_ROWS ((CHAROUT_PAGES*PAGE_SIZE) / (SCREEN_COL_SIZE*2))   // rows in the text window
+
+#define HISTORY_BYTES 16384         // compressed rows, power of two
+#define HISTORY_ROWS  1024          // at most this many rows, power of two
+
+
+/**
+ * rows which were scrolled off the screen, run-length encoded in a ring buffer
+ */
+struct History
+{
+	u8 data[HISTORY_BYTES];
+	u32 head;                       // end of the data, counts all bytes ever written
+
+	u32 row_pos[HISTORY_ROWS];      // start of each row in the data
+	u32 first_row, end_row;         // stored rows [first_row, end_row[, counting all rows
+
+	i32 view;                       // rows paged back, 0: the screen is shown
+	i32 saved_rows;                 // screen rows put into the history while paging
+};
+
+
+/**
+ * off-screen copy of the text screen, only changed cells are written to video memory
+ */
+struct Screen
+{
+	// character in the low, attribute in the high byte, aligned for word-wise copying
+	u16 cells[SCREEN_SIZE] __attribute__((aligned(8)));
+	volatile u16 *vram;             // whole text window
+
+	// hardware scrolling: the screen shows the window's rows starting at origin
+	seL4_CPtr crtc_port;            // 0: scroll by copying
+	u32 origin;
+	u32 shown_origin;               // origin programmed in the crt controller
+
+	// hardware cursor, only moved when flushing
+	i32 cursor_x, cursor_y;
+	u32 shown_cursor;               // address programmed in the crt controller
+
+	// changed columns [dirty_begin, dirty_end[ of each row, none if dirty_begin >= dirty_end
+	u8 dirty_begin[SCREEN_ROW_SIZE];
+	u8 dirty_end[SCREEN_ROW_SIZE];
+
+	struct History *history;        // keeps the scrolled rows, 0: none
+};
+
+
+extern void screen_init(struct Screen* scr, i8* vram, seL4_CPtr crtc_port, u8 attr);
+extern void screen_put(struct Screen* scr, i32 x, i32 y, i8 ch, u8 attr);
+extern void screen_write(struct Screen* scr, i32 x, i32 y, const i8* str, u8 attr);
+extern void screen_set_attr(struct Screen* scr, i32 x, i32 y, u8 attr);
+extern void screen_set_cursor(struct Screen* scr, i32 x, i32 y);
+extern void screen_clear(struct Screen* scr, i32 y_begin, i32 y_end, u8 attr);
+extern void screen_scroll(struct Screen* scr, i32 y_begin, i32 y_end, i32 lines, u8 attr);
+extern void screen_flush(struct Screen* scr);
+
+extern void screen_set_history(struct Screen* scr, struct History* history);
+extern void screen_page(struct Screen* scr, i32 y_begin, i32 y_end, i32 lines);
+
+
+#endif
@@ -14,6 +14,8 @@
  *   - https://docs.sel4.systems/projects/sel4/api-doc.html
  * References for keyboard input:
  *   - https://wiki.osdev.org/%228042%22_PS/2_Controller
+ * References for serial output:
+ *   - https://wiki.osdev.org/Serial_Ports
  * References for screen output:
  *   - https://wiki.osdev.org/Printing_To_Screen
  *   - https://jbwyatt.com/253/emu/memory.html
@@ -26,6 +28,7 @@
 #include "defines.h"
 #include "string.h"
 #include "shell.h"
+#include "serial.h"
 
 #include <sel4/sel4.h>
 #include <sel4platsupport/bootinfo.h>
@@ -42,6 +45,13 @@ struct Keyboard
 // some (arbitrary) badge number for the thread endpoint
 #define CALCTHREAD_BADGE 1234
 
+// badges telling the main thread's notifications apart
+#define KEYB_BADGE       (1 << 0)
+#define SERIAL_BADGE     (1 << 1)
+
+// the main thread's output, which goes to the debug console until serial_init()
+#define console_printf(...) serial_printf(&serial_console, SERIAL_MAIN, __VA_ARGS__)
+
 
 /**
  * print slot usage
@@ -191,44 +201,62 @@ void map_pagetables(seL4_SlotPos untyped_start, seL4_SlotPos untyped_end,
 
 
 /**
- * map a page into a given virtual address
+ * map consecutive pages into a given virtual address, logging them in one line
+ * @return slot of the first page
  * @see https://github.com/seL4/sel4-tutorials/blob/master/tutorials/mapping/mapping.md
  */
-seL4_SlotPos map_page(seL4_SlotPos untyped_start, seL4_SlotPos untyped_end,
+seL4_SlotPos map_pages(seL4_SlotPos untyped_start, seL4_SlotPos untyped_end,
 	const seL4_UntypedDesc* untyped_list, seL4_SlotPos* cur_slot,
-	word_t virt_addr)
+	word_t virt_addr, word_t num_pages)
 {
 	const seL4_SlotPos cnode = seL4_CapInitThreadCNode;
 	const seL4_SlotPos vspace = seL4_CapInitThreadVSpace;
 	seL4_X86_VMAttributes vmattr = seL4_X86_Default_VMAttributes;
 
-	seL4_SlotPos base_slot = find_untyped(untyped_start, untyped_end, untyped_list, PAGE_SIZE);
-	printf("Using device memory slot 0x%lx.\n", base_slot);
+	seL4_SlotPos first_page_slot = 0;
+	for(word_t page=0; page<num_pages; ++page)
+	{
+		seL4_SlotPos base_slot = find_untyped(untyped_start, untyped_end, untyped_list, PAGE_SIZE);
+		seL4_SlotPos page_slot = (*cur_slot)++;
+		seL4_Untyped_Retype(base_slot, PAGE_TYPE, 0, cnode, 0, 0, page_slot, 1);
 
-	seL4_SlotPos page_slot = (*cur_slot)++;
-	seL4_Untyped_Retype(base_slot, PAGE_TYPE, 0, cnode, 0, 0, page_slot, 1);
+		if(seL4_X86_Page_Map(page_slot, vspace, virt_addr + page*PAGE_SIZE,
+			seL4_AllRights, vmattr) != seL4_NoError)
+		{
+			console_printf("Error mapping page!\n");
+		}
 
-	if(seL4_X86_Page_Map(page_slot, vspace, virt_addr, seL4_AllRights, vmattr)
-		!= seL4_NoError)
-	{
-		printf("Error mapping page!\n");
+		if(page == 0)
+			first_page_slot = page_slot;
 	}
 
-	seL4_X86_Page_GetAddress_t addr_info = seL4_X86_Page_GetAddress(page_slot);
-	printf("Mapped virtual address: 0x%lx -> physical address: 0x%lx.\n",
-		virt_addr, addr_info.paddr);
+	seL4_X86_Page_GetAddress_t addr_info = seL4_X86_Page_GetAddress(first_page_slot);
+	console_printf("Mapped %lu page(s) at virtual address: 0x%lx -> physical address: 0x%lx.\n",
+		num_pages, virt_addr, addr_info.paddr);
 
-	return page_slot;
+	return first_page_slot;
 }
 
 
 /**
- * map a given physical address into a given virtual address
+ * map a page into a given virtual address
+ */
+seL4_SlotPos map_page(seL4_SlotPos untyped_start, seL4_SlotPos untyped_end,
+	const seL4_UntypedDesc* untyped_list, seL4_SlotPos* cur_slot,
+	word_t virt_addr)
+{
+	return map_pages(untyped_start, untyped_end, untyped_list, cur_slot, virt_addr, 1);
+}
+
+
+/**
+ * map consecutive pages starting at a given physical address into a given virtual address
+ * @return slot of the first page
  * @see https://github.com/seL4/sel4-tutorials/blob/master/tutorials/mapping/mapping.md
  */
 seL4_SlotPos map_page_phys(seL4_SlotPos untyped_start, seL4_SlotPos untyped_end,
 	const seL4_UntypedDesc* untyped_list, seL4_SlotPos* cur_slot,
-	word_t virt_addr, word_t phys_addr)
+	word_t virt_addr, word_t phys_addr, word_t num_pages)
 {
 	const seL4_SlotPos cnode = seL4_CapInitThreadCNode;
 	const seL4_SlotPos vspace = seL4_CapInitThreadVSpace;
@@ -250,17 +278,28 @@ seL4_SlotPos map_page_phys(seL4_SlotPos untyped_start, seL4_SlotPos untyped_end,
 	//seL4_SlotPos frame_slot = (*cur_slot)++;
 	//seL4_Untyped_Retype(base_slot, seL4_X86_LargePageObject, 0, cnode, 0, 0, frame_slot, 1);
 
-	if(seL4_X86_Page_Map(page_slot, vspace, virt_addr, seL4_ReadWrite, vmattr)
-		!= seL4_NoError)
+	seL4_SlotPos first_page_slot = page_slot;
+	for(word_t page=0; page<num_pages; ++page)
 	{
-		printf("Error mapping page!\n");
-	}
+		// the following frames are retyped in order
+		if(page > 0)
+		{
+			page_slot = (*cur_slot)++;
+			seL4_Untyped_Retype(base_slot, PAGE_TYPE, 0, cnode, 0, 0, page_slot, 1);
+		}
+
+		if(seL4_X86_Page_Map(page_slot, vspace, virt_addr + page*PAGE_SIZE,
+			seL4_ReadWrite, vmattr) != seL4_NoError)
+		{
+			printf("Error mapping page!\n");
+		}
 
-	seL4_X86_Page_GetAddress_t addr_info = seL4_X86_Page_GetAddress(page_slot);
-	printf("Mapped virtual address: 0x%lx -> physical address: 0x%lx.\n",
-		virt_addr, addr_info.paddr);
+		seL4_X86_Page_GetAddress_t addr_info = seL4_X86_Page_GetAddress(page_slot);
+		printf("Mapped virtual address: 0x%lx -> physical address: 0x%lx.\n",
+			virt_addr + page*PAGE_SIZE, addr_info.paddr);
+	}
 
-	return page_slot;
+	return first_page_slot;
 }
 
 
@@ -322,18 +361,52 @@ i64 main()
 	// (arbitrary) virtual addresses to map page tables, video ram and the TCB stack into
 	// ------------------------------------------------------------------------
 	word_t virt_addr_tables = 0x8000000000;
-	word_t virt_addr_char = 0x8000001000;
 	word_t virt_addr_tcb_stack = 0x8000002000;
 	word_t virt_addr_tcb_tls = 0x8000003000;
 	word_t virt_addr_tcb_ipcbuf = 0x8000004000;
 	word_t virt_addr_tcb_tlsipc = virt_addr_tcb_tls + 0x10;
+	word_t virt_addr_jit = 0x8000005000;
+	word_t virt_addr_parser_heap = 0x8000100000; // PARSER_HEAP_PAGES pages, within the page table's 2 MiB
+	word_t virt_addr_char = 0x8000020000;       // text window of CHAROUT_PAGES pages
 
 	// map the page tables
 	map_pagetables(untyped_start, untyped_end, untyped_list, &cur_slot, virt_addr_tables);
 
-	// find page whose frame contains the vga memory
+	// find page whose frame contains the vga memory, and the rest of the text window
 	seL4_SlotPos page_slot = map_page_phys(untyped_start, untyped_end,
-		untyped_list, &cur_slot, virt_addr_char, CHAROUT_PHYS);
+		untyped_list, &cur_slot, virt_addr_char, CHAROUT_PHYS, CHAROUT_PAGES);
+	// ------------------------------------------------------------------------
+
+
+	// ------------------------------------------------------------------------
+	// serial console, drained by the main thread
+	// ------------------------------------------------------------------------
+	// the keyboard and the uart signal the main thread with different badges
+	seL4_SlotPos irq_notify = get_slot(seL4_NotificationObject, 1<<seL4_NotificationBits,
+		untyped_start, untyped_end, untyped_list, &cur_slot, this_cnode);
+
+	seL4_SlotPos serial_port = cur_slot++;
+	if(seL4_X86_IOPortControl_Issue(this_ioctrl, SERIAL_PORT, SERIAL_PORT + 7,
+		this_cnode, serial_port, seL4_WordBits) != seL4_NoError)
+	{
+		printf("Error getting serial port IO control!\n");
+		serial_port = 0;
+	}
+
+	seL4_SlotPos serial_irq = cur_slot++;
+	if(seL4_IRQControl_GetIOAPIC(this_irqctrl, this_cnode, serial_irq,
+		seL4_WordBits, SERIAL_PIC, SERIAL_IRQ, 0, 1, SERIAL_INT) != seL4_NoError)
+		printf("Error getting serial interrupt control!\n");
+
+	seL4_SlotPos serial_notify = cur_slot++;
+	if(seL4_CNode_Mint(this_cnode, serial_notify, seL4_WordBits, this_cnode,
+		irq_notify, seL4_WordBits, seL4_AllRights, SERIAL_BADGE) != seL4_NoError)
+		printf("Error: Minting of serial notifier failed.");
+	if(seL4_IRQHandler_SetNotification(serial_irq, serial_notify) != seL4_NoError)
+		printf("Error setting serial interrupt notification!\n");
+
+	// before the shell thread, which writes to it
+	serial_init(&serial_console, serial_port, serial_irq, serial_notify);
 	// ------------------------------------------------------------------------
 
 
@@ -351,26 +424,42 @@ i64 main()
 	seL4_SlotPos page_slot_tcb_ipcbuf = map_page(untyped_start, untyped_end,
 		untyped_list, &cur_slot, virt_addr_tcb_ipcbuf);
 
+	// executable page for the expression compiler's native code
+	map_page(untyped_start, untyped_end, untyped_list, &cur_slot, virt_addr_jit);
+
+	// memory for the parser, so that it doesn't need a heap
+	map_pages(untyped_start, untyped_end, untyped_list, &cur_slot,
+		virt_addr_parser_heap, PARSER_HEAP_PAGES);
+
+	// crt controller ports for the shell's hardware scrolling
+	seL4_SlotPos crtc_slot = cur_slot++;
+	if(seL4_X86_IOPortControl_Issue(this_ioctrl, CRTC_ADDR_PORT, CRTC_DATA_PORT,
+		this_cnode, crtc_slot, seL4_WordBits) != seL4_NoError)
+	{
+		console_printf("Error getting CRT controller IO control!\n");
+		crtc_slot = 0;
+	}
+
 	seL4_SlotPos tcb = get_slot(seL4_TCBObject, 1<<seL4_TCBBits,
 		untyped_start, untyped_end, untyped_list, &cur_slot, this_cnode);
 
 	// the child thread uses the main thread's cnode and vspace
 	if(seL4_TCB_SetSpace(tcb, 0, this_cnode, 0, this_vspace, 0) != seL4_NoError)
-		printf("Error: Cannot set TCB space!\n");
+		console_printf("Error: Cannot set TCB space!\n");
 
 	// set up thread local storage
 	if(seL4_TCB_SetTLSBase(tcb, virt_addr_tcb_tlsipc) != seL4_NoError)
-		printf("Error: Cannot set TCB IPC buffer!\n");
+		console_printf("Error: Cannot set TCB IPC buffer!\n");
 
 	// set up the ipc buffer
 	if(seL4_TCB_SetIPCBuffer(tcb, virt_addr_tcb_ipcbuf, page_slot_tcb_ipcbuf) != seL4_NoError)
-		printf("Error: Cannot set TCB IPC buffer!\n");
+		console_printf("Error: Cannot set TCB IPC buffer!\n");
 
 	*(const seL4_IPCBuffer**)virt_addr_tcb_tls = this_ipcbuffer /*__sel4_ipc_buffer*/;
 
 	// doesn't seem to get scheduled otherwise...
 	if(seL4_TCB_SetPriority(tcb, this_tcb, seL4_MaxPrio) != seL4_NoError)
-		printf("Error: Cannot set TCB priority!\n");
+		console_printf("Error: Cannot set TCB priority!\n");
 
 	// create semaphores for thread signalling
 	seL4_SlotPos tcb_startnotify = get_slot(seL4_NotificationObject, 1<<seL4_NotificationBits,
@@ -384,12 +473,12 @@ i64 main()
 	seL4_SlotPos tcb_startnotify2 = cur_slot++;
 	if(seL4_CNode_Mint(this_cnode, tcb_startnotify2, seL4_WordBits, this_cnode,
 		tcb_startnotify, seL4_WordBits, seL4_AllRights, tcb_badge) != seL4_NoError)
-		printf("Error: Minting of start notifier failed.");
+		console_printf("Error: Minting of start notifier failed.");
 
 	seL4_SlotPos tcb_endpoint2 = cur_slot++;
 	if(seL4_CNode_Mint(this_cnode, tcb_endpoint2, seL4_WordBits, this_cnode,
 		tcb_endpoint, seL4_WordBits, seL4_AllRights, tcb_badge) != seL4_NoError)
-		printf("Error: Minting of thread endpoint failed.");
+		console_printf("Error: Minting of thread endpoint failed.");
 
 	seL4_UserContext tcb_context;
 	i32 num_regs = sizeof(tcb_context)/sizeof(tcb_context.rax);
@@ -403,24 +492,29 @@ i64 main()
 	tcb_context.rdi = (word_t)tcb_startnotify2; // arg 1: start notification
 	tcb_context.rsi = (word_t)virt_addr_char;   // arg 2: vga ram
 	tcb_context.rdx = (word_t)tcb_endpoint;     // arg 3: ipc endpoint
+	tcb_context.rcx = (word_t)virt_addr_jit;    // arg 4: executable memory
+	tcb_context.r8 = (word_t)virt_addr_parser_heap; // arg 5: parser memory
+	tcb_context.r9 = (word_t)crtc_slot;         // arg 6: crt controller ports
 
-	printf("rip = 0x%lx, rsp = 0x%lx, rflags = 0x%lx, rdi = 0x%lx, rsi = 0x%lx, rdx = 0x%lx.\n",
+	console_printf("rip = 0x%lx, rsp = 0x%lx, rflags = 0x%lx, rdi = 0x%lx, rsi = 0x%lx, rdx = 0x%lx, "
+		"rcx = 0x%lx, r8 = 0x%lx, r9 = 0x%lx.\n",
 		tcb_context.rip, tcb_context.rsp, tcb_context.rflags,
-		tcb_context.rdi, tcb_context.rsi, tcb_context.rdx);
+		tcb_context.rdi, tcb_context.rsi, tcb_context.rdx,
+		tcb_context.rcx, tcb_context.r8, tcb_context.r9);
 
 	// write registers and start thread
 	if(seL4_TCB_WriteRegisters(tcb, 1, 0, num_regs, &tcb_context) != seL4_NoError)
-		printf("Error writing TCB registers!\n");
+		console_printf("Error writing TCB registers!\n");
 
-	printf("Waiting for thread to start...\n");
+	console_printf("Waiting for thread to start...\n");
 	word_t start_badge;
 	seL4_Wait(tcb_startnotify, &start_badge);
-	printf("Thread started, badge: %ld.\n", start_badge);
+	console_printf("Thread started, badge: %ld.\n", start_badge);
 	// ------------------------------------------------------------------------
 
 
 	// ------------------------------------------------------------------------
-	// keyboard interrupt service routine
+	// keyboard and serial interrupt service routine
 	// @see https://github.com/seL4/sel4-tutorials/blob/master/tutorials/interrupts/interrupts.md
 	// ------------------------------------------------------------------------
 	struct Keyboard keyb;
@@ -429,31 +523,41 @@ i64 main()
 	keyb.keyb_slot = cur_slot++;
 	if(seL4_X86_IOPortControl_Issue(this_ioctrl, KEYB_DATA_PORT, KEYB_DATA_PORT,
 		this_cnode, keyb.keyb_slot, seL4_WordBits) != seL4_NoError)
-		printf("Error getting keyboard IO control!\n");
+		console_printf("Error getting keyboard IO control!\n");
 
 	keyb.irq_slot = cur_slot++;
 	//seL4_IRQControl_Get(this_irqctrl, KEYB_IRQ, this_cnode, keyb.irq_slot, seL4_WordBits);
 	if(seL4_IRQControl_GetIOAPIC(this_irqctrl, this_cnode, keyb.irq_slot,
 		seL4_WordBits, KEYB_PIC, KEYB_IRQ, 0, 1, KEYB_INT) != seL4_NoError)
-		printf("Error getting keyboard interrupt control!\n");
+		console_printf("Error getting keyboard interrupt control!\n");
 
-	keyb.irq_notify = get_slot(seL4_NotificationObject, 1<<seL4_NotificationBits,
-		untyped_start, untyped_end, untyped_list, &cur_slot, this_cnode);
+	keyb.irq_notify = cur_slot++;
+	if(seL4_CNode_Mint(this_cnode, keyb.irq_notify, seL4_WordBits, this_cnode,
+		irq_notify, seL4_WordBits, seL4_AllRights, KEYB_BADGE) != seL4_NoError)
+		console_printf("Error: Minting of keyboard notifier failed.");
 	if(seL4_IRQHandler_SetNotification(keyb.irq_slot, keyb.irq_notify) != seL4_NoError)
-		printf("Error setting keyboard interrupt notification!\n");
+		console_printf("Error setting keyboard interrupt notification!\n");
 
 	while(1)
 	{
-		seL4_Wait(keyb.irq_notify, 0);
+		word_t badge = 0;
+		seL4_Wait(irq_notify, &badge);
+
+		// the uart's transmitter is empty or the shell has written to the console
+		if(badge & SERIAL_BADGE)
+			serial_drain(&serial_console);
+
+		if(!(badge & KEYB_BADGE))
+			continue;
+
 		seL4_X86_IOPort_In8_t key = seL4_X86_IOPort_In8(keyb.keyb_slot, KEYB_DATA_PORT);
 
 		if(key.error != seL4_NoError)
 		{
-			printf("Error reading keyboard port!\n");
+			console_printf("Error reading keyboard port!\n");
 		}
 		else
 		{
-			printf("Key code: 0x%x.\n", key.result);
 			seL4_IRQHandler_Ack(keyb.irq_slot);
 
 			// save the key code in the message register
@@ -471,8 +575,8 @@ i64 main()
 	seL4_CNode_Revoke(this_cnode, page_slot_tcb_stack, seL4_WordBits);
 	seL4_CNode_Revoke(this_cnode, page_slot, seL4_WordBits);
 
-	printf("--------------------------------------------------------------------------------\n");
-	printf("Main thread has ended.\n");
+	console_printf("--------------------------------------------------------------------------------\n");
+	console_printf("Main thread has ended.\n");
 	while(1) seL4_Yield();
 	// ------------------------------------------------------------------------
 
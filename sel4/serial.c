@@ -0,0 +1,226 @@
+/**
+ * buffered serial console
+ *
+ * writing only copies the output into the writer thread's ring buffer, which
+ * the driver sends to the uart's fifo whenever the transmitter becomes empty;
+ * so the writer does not wait for the serial line, and output which does not
+ * fit into the buffer is dropped and reported later instead of blocking
+ *
+ * @author agent
+ * @date 16-oct-2026
+ * @license GPLv3, see 'LICENSE' file
+ *
+ * References:
+ *   - https://wiki.osdev.org/Serial_Ports
+ *   - https://en.wikibooks.org/wiki/Serial_Programming/8250_UART_Programming
+ *   - https://github.com/seL4/sel4-tutorials/blob/master/tutorials/interrupts/interrupts.md
+ */
+
+#include "serial.h"
+#include "string.h"
+
+#include <stdarg.h>
+
+
+// uart registers, offsets to SERIAL_PORT
+#define UART_THR 0          // transmitter holding register
+#define UART_DLL 0          // divisor, low byte, if LCR_DLAB is set
+#define UART_IER 1          // interrupt enable
+#define UART_DLM 1          // divisor, high byte, if LCR_DLAB is set
+#define UART_FCR 2          // fifo control
+#define UART_LCR 3          // line control
+#define UART_MCR 4          // modem control
+#define UART_LSR 5          // line status
+
+#define IER_THR_EMPTY  0x02 // interrupt when the transmitter holding register is empty
+#define FCR_ENABLE     0x07 // enable and clear the fifos
+#define LCR_8N1        0x03 // eight data bits, no parity, one stop bit
+#define LCR_DLAB       0x80 // access the divisor
+#define MCR_OUT2       0x0b // dtr, rts and out2, which connects the interrupt line
+#define LSR_THR_EMPTY  0x20 // the transmitter holding register and its fifo are empty
+
+#define UART_FIFO_SIZE 16
+#define UART_DIVISOR   1    // 115200 baud
+
+
+struct SerialConsole serial_console;
+
+
+static void uart_out(struct SerialConsole* con, u16 reg, u8 val)
+{
+	seL4_X86_IOPort_Out8(con->port, SERIAL_PORT + reg, val);
+}
+
+
+/**
+ * @param port capability for the uart's ports, 0: write to the debug console instead
+ * @param irq handler of the uart's interrupt, which signals the wake notification
+ * @param wake notification the driver waits on
+ */
+void serial_init(struct SerialConsole* con, seL4_CPtr port, seL4_CPtr irq, seL4_CPtr wake)
+{
+	for(int i=0; i<SERIAL_WRITERS; ++i)
+	{
+		struct SerialRing *ring = con->rings + i;
+		atomic_init(&ring->head, 0);
+		atomic_init(&ring->tail, 0);
+		ring->dropped = ring->dropped_shown = 0;
+	}
+
+	con->cur_ring = 0;
+	atomic_init(&con->idle, 1);
+
+	con->port = port;
+	con->irq = irq;
+	con->wake = wake;
+
+	if(!port)
+		return;
+
+	uart_out(con, UART_IER, 0);
+	uart_out(con, UART_LCR, LCR_DLAB);
+	uart_out(con, UART_DLL, UART_DIVISOR & 0xff);
+	uart_out(con, UART_DLM, UART_DIVISOR >> 8);
+	uart_out(con, UART_LCR, LCR_8N1);
+	uart_out(con, UART_FCR, FCR_ENABLE);
+	uart_out(con, UART_MCR, MCR_OUT2);
+	uart_out(con, UART_IER, IER_THR_EMPTY);
+}
+
+
+static u32 put_bytes(struct SerialRing* ring, u32 head, const i8* str, u64 len)
+{
+	for(u64 i=0; i<len; ++i)
+		ring->tx[head++ & (SERIAL_TX_SIZE - 1)] = (u8)str[i];
+	return head;
+}
+
+
+/**
+ * queue the output without waiting for the uart, only to be called by the given writer thread
+ */
+void serial_write(struct SerialConsole* con, enum SerialWriter writer, const i8* str, u64 len)
+{
+	if(!con->port)
+	{
+		printf("%.*s", (int)len, str);
+		return;
+	}
+
+	struct SerialRing *ring = con->rings + writer;
+	u32 head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	u32 tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+	u64 space = SERIAL_TX_SIZE - (head - tail);
+
+	// report lost output before the next one which fits
+	i8 mem[64];
+	struct StrBuf note;
+	strbuf_init(&note, mem, sizeof(mem));
+	if(ring->dropped != ring->dropped_shown)
+	{
+		strbuf_append(&note, "\n[serial console: ");
+		strbuf_append_uint(&note, ring->dropped - ring->dropped_shown, 10);
+		strbuf_append(&note, " bytes dropped]\n");
+	}
+
+	// only whole messages are sent
+	if(note.len + len > space)
+	{
+		ring->dropped += len;
+		return;
+	}
+
+	head = put_bytes(ring, head, note.str, note.len);
+	head = put_bytes(ring, head, str, len);
+	ring->dropped_shown = ring->dropped;
+	atomic_store_explicit(&ring->head, head, memory_order_release);
+
+	if(atomic_exchange_explicit(&con->idle, 0, memory_order_seq_cst))
+		seL4_Signal(con->wake);
+}
+
+
+#if SERIAL_DEBUG != 0
+/**
+ * formatted output, replacing printf once the driver owns the uart
+ */
+void serial_printf(struct SerialConsole* con, enum SerialWriter writer, const char* fmt, ...)
+{
+	char str[256];
+
+	va_list args;
+	va_start(args, fmt);
+	int len = vsnprintf(str, sizeof(str), fmt, args);
+	va_end(args);
+
+	if(len < 0)
+		return;
+	if(len >= (int)sizeof(str))
+		len = sizeof(str) - 1;
+
+	serial_write(con, writer, (const i8*)str, len);
+}
+#endif
+
+
+/**
+ * the number of bytes left to send in a ring
+ */
+static u32 ring_pending(struct SerialRing* ring, u32* tail, memory_order order)
+{
+	*tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+	return atomic_load_explicit(&ring->head, order) - *tail;
+}
+
+
+/**
+ * fill the uart's fifo from the buffers, called by the driver
+ * on the uart's interrupt and when a writer wakes it
+ */
+void serial_drain(struct SerialConsole* con)
+{
+	if(!con->port)
+		return;
+
+	while(1)
+	{
+		seL4_X86_IOPort_In8_t lsr = seL4_X86_IOPort_In8(con->port, SERIAL_PORT + UART_LSR);
+		if(lsr.error != seL4_NoError || !(lsr.result & LSR_THR_EMPTY))
+			break;
+
+		// a buffer is only left once it is empty, which is between two of its messages
+		u32 tail = 0, num = 0;
+		for(int i=0; i<SERIAL_WRITERS && !num; ++i)
+		{
+			struct SerialRing *ring = con->rings + con->cur_ring;
+			num = ring_pending(ring, &tail, memory_order_acquire);
+			if(!num)
+				con->cur_ring = (con->cur_ring + 1) % SERIAL_WRITERS;
+		}
+
+		if(num)
+		{
+			if(num > UART_FIFO_SIZE)
+				num = UART_FIFO_SIZE;
+
+			struct SerialRing *ring = con->rings + con->cur_ring;
+			for(u32 i=0; i<num; ++i)
+				uart_out(con, UART_THR, ring->tx[(tail + i) & (SERIAL_TX_SIZE - 1)]);
+			atomic_store_explicit(&ring->tail, tail + num, memory_order_release);
+
+			// the next interrupt comes once these bytes are sent
+			break;
+		}
+
+		// nothing left, a writer wakes the driver for its next output,
+		// unless that has been written in the meantime
+		atomic_store_explicit(&con->idle, 1, memory_order_seq_cst);
+		int written = 0;
+		for(int i=0; i<SERIAL_WRITERS; ++i)
+			written |= ring_pending(con->rings + i, &tail, memory_order_seq_cst) != 0;
+		if(!written || !atomic_exchange_explicit(&con->idle, 0, memory_order_seq_cst))
+			break;
+	}
+
+	seL4_IRQHandler_Ack(con->irq);
+}
@@ -0,0 +1,76 @@
+/**
+ * buffered serial console
+ * @author agent
+ * @date 16-oct-2026
+ * @license GPLv3, see 'LICENSE' file
+ *
+ * References:
+ *   - https://wiki.osdev.org/Serial_Ports
+ *   - https://github.com/seL4/sel4-tutorials/blob/master/tutorials/interrupts/interrupts.md
+ */
+
+#ifndef __SERIAL_H__
+#define __SERIAL_H__
+
+#include <stdatomic.h>
+
+#include "defines.h"
+
+
+/**
+ * threads writing to the console, each one fills its own buffer
+ */
+enum SerialWriter
+{
+	SERIAL_MAIN = 0,                // the main thread, which also drives the uart
+	SERIAL_SHELL,                   // the calculator thread
+
+	SERIAL_WRITERS
+};
+
+
+/**
+ * output ring buffer of one writer thread
+ */
+struct SerialRing
+{
+	u8 tx[SERIAL_TX_SIZE];
+	_Atomic u32 head;               // written bytes, only changed by the writer
+	_Atomic u32 tail;               // sent bytes, only changed by the driver
+
+	u64 dropped;                    // bytes which did not fit into the buffer
+	u64 dropped_shown;              // dropped bytes already reported in the output
+};
+
+
+/**
+ * output of the uart, sent by the driver, which is woken by the uart's interrupt or a writer
+ */
+struct SerialConsole
+{
+	struct SerialRing rings[SERIAL_WRITERS];
+	int cur_ring;                   // the buffer being sent, only changed by the driver
+	_Atomic int idle;               // nothing is being sent, a writer has to wake the driver
+
+	seL4_CPtr port;                 // capability for the uart's ports, 0: use the debug console
+	seL4_CPtr irq;                  // the uart's interrupt handler
+	seL4_CPtr wake;                 // notification of the driver
+};
+
+
+// shared by the program's threads
+extern struct SerialConsole serial_console;
+
+
+extern void serial_init(struct SerialConsole* con, seL4_CPtr port, seL4_CPtr irq, seL4_CPtr wake);
+extern void serial_write(struct SerialConsole* con, enum SerialWriter writer, const i8* str, u64 len);
+extern void serial_drain(struct SerialConsole* con);
+
+#if SERIAL_DEBUG != 0
+	extern void serial_printf(struct SerialConsole* con, enum SerialWriter writer, const char* fmt, ...);
+#else
+	#define serial_printf(...) {}
+#endif
+
+
+#endif
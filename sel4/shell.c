@@ -21,37 +21,69 @@
  */
 
 #include "shell.h"
+#include "screen.h"
+#include "serial.h"
 #include "string.h"
 #include "expr_parser.h"
+#include "expr_jit.h"
 
 
-void run_calc_shell(seL4_SlotPos start_notify, i8 *charout, seL4_SlotPos endpoint)
+// too large for the thread's stack
+static struct Screen screen;
+static struct History history;
+
+
+static void write_serial(void* con, const char* str, u64 len)
+{
+	serial_write((struct SerialConsole*)con, SERIAL_SHELL, (const i8*)str, len);
+}
+
+// messages of the parser go to the buffered serial console
+static const struct ExprConsole console = { &write_serial, &serial_console };
+
+// the thread's output, printf's debug console would share the uart with the serial console
+#define console_printf(...) serial_printf(&serial_console, SERIAL_SHELL, __VA_ARGS__)
+
+
+void run_calc_shell(seL4_SlotPos start_notify, i8 *charout, seL4_SlotPos endpoint,
+	u8 *jit_mem, u8 *parser_mem, seL4_SlotPos crtc_port)
 {
-	printf("Start of calculator thread, endpoint: %ld.\n", endpoint);
+	console_printf("Start of calculator thread, endpoint: %ld.\n", endpoint);
 	seL4_Signal(start_notify);
 
 	i32 x_min = 1, y_min = 2;
 	i32 x_max = SCREEN_COL_SIZE-1;
 
 	i32 x=x_min, y=y_min;
-	i32 x_prev=x, y_prev=y;
 
 	struct ParserContext ctx;
-	init_parser(&ctx);
+	if(!init_parser_mem(&ctx, parser_mem, PARSER_HEAP_PAGES*PAGE_SIZE))
+		console_printf("Error: Cannot initialise the parser, its memory is too small.\n");
+	init_jit(&ctx, jit_mem, PAGE_SIZE);
+	ctx.console = &console;
+
+	// the typed line is kept and lexed here, so it need not be read back from the screen
+	struct ExprLine line;
+	if(!init_line(&ctx, &line, x_max - x_min))
+	{
+		// nothing can be typed without the line
+		console_printf("Error: Cannot allocate the input line, ending calculator thread.\n");
+		deinit_parser(&ctx);
+		while(1) seL4_Yield();
+	}
 
-	clear_scr(ATTR_NORM, charout, SCREEN_SIZE);
-	write_str("Seminar 1914             seL4 Calculator Shell ver. 0.2                   tweber",
-		ATTR_INV, charout);
+	screen_init(&screen, charout, crtc_port, ATTR_NORM);
+	screen_write(&screen, 0, 0,
+		"Seminar 1914             seL4 Calculator Shell ver. 0.2                   tweber",
+		ATTR_INV);
+	screen_set_history(&screen, &history);
 
 	u64 output_num = 1;
 	while(1)
 	{
-		// cursor
-		charout[(y_prev*SCREEN_COL_SIZE + x_prev)*2 + 1] = ATTR_NORM;
-		charout[(y*SCREEN_COL_SIZE + x)*2 + 1] = ATTR_INV;
-
-		x_prev = x;
-		y_prev = y;
+		// show everything which changed while handling the last key
+		screen_set_cursor(&screen, x, y);
+		screen_flush(&screen);
 
 		word_t badge = 0;
 		seL4_MessageInfo_t msg = seL4_Recv(endpoint, &badge);
@@ -60,28 +92,52 @@ void run_calc_shell(seL4_SlotPos start_notify, i8 *charout, seL4_SlotPos endpoin
 		i16 key = seL4_GetMR(0);
 		seL4_Reply(msg);
 
-		if(key == 0x1c)	// enter
+		if(key == 0x49 || key == 0x51)	// page up, page down
 		{
-			// read current line
-			i8 line[SCREEN_COL_SIZE+1];
-			read_str(line, charout+y*SCREEN_COL_SIZE*2 + x_min*2, SCREEN_COL_SIZE);
-			t_value val = parse(&ctx, line);
-
-			i8 outnumbuf[64];
-			int_to_str(output_num, 10, outnumbuf);
+			i32 page = SCREEN_ROW_SIZE - 2;
+			screen_page(&screen, 1, SCREEN_ROW_SIZE, key == 0x49 ? page : -page);
+			continue;
+		}
 
-			i8 numbuf[64];
-			my_strncpy(numbuf, "[out ", sizeof(numbuf));
-			my_strncat(numbuf, outnumbuf, sizeof(numbuf));
-			my_strncat(numbuf, "] ", sizeof(numbuf));
-			u64 numbuf_idx = my_strlen(numbuf);
+		// any other key press shows the screen again
+		if(key < 0x80 && history.view)
+			screen_page(&screen, 1, SCREEN_ROW_SIZE, -history.view);
 
+		if(key == 0x1c)	// enter
+		{
+			// only parsing the tokens and evaluating is left to do
+			clear_diagnostics(&ctx);
+			t_value val = 0;
+			int status = try_parse_line(&ctx, &line, &val);
+			clear_line(&line);
+
+			i8 numbuf[SCREEN_COL_SIZE-1];
+			struct StrBuf out;
+			strbuf_init(&out, numbuf, sizeof(numbuf));
+			strbuf_append(&out, status == EXPR_OK ? "[out " : "[err ");
+			strbuf_append_uint(&out, output_num, 10);
+			strbuf_append(&out, "] ");
+
+			if(status == EXPR_OK)
+			{
 #ifdef USE_INTEGER
-			int_to_str(val, 10, numbuf+numbuf_idx);
+				strbuf_append_int(&out, val, 10);
 #else
-			real_to_str(val, 10, numbuf+numbuf_idx, 8);
+				strbuf_append_real(&out, val);
 #endif
-			write_str(numbuf, ATTR_BOLD, charout + (y+1)*SCREEN_COL_SIZE*2 + x_min*2);
+			}
+			else
+			{
+				// show the first error of this line
+				const struct Diagnostic *diag = get_diagnostic(&ctx, 0);
+				strbuf_append(&out, error_message(status));
+				if(diag && diag->text[0])
+				{
+					strbuf_append(&out, ": ");
+					strbuf_append(&out, diag->text);
+				}
+			}
+			screen_write(&screen, x_min, y+1, numbuf, ATTR_BOLD);
 
 			print_symbols(&ctx);
 
@@ -93,27 +149,16 @@ void run_calc_shell(seL4_SlotPos start_notify, i8 *charout, seL4_SlotPos endpoin
 			// scroll
 			if(y >= SCREEN_ROW_SIZE - 2)
 			{
-				// reset cursor
-				charout[(y_prev*SCREEN_COL_SIZE + x_prev)*2 + 1] = ATTR_NORM;
-
-				for(u32 _y = 3; _y < SCREEN_ROW_SIZE; ++_y)
-				{
-					my_memcpy(
-						charout+SCREEN_COL_SIZE*(_y-2)*2,
-						charout+SCREEN_COL_SIZE*_y*2,
-						SCREEN_COL_SIZE*2);
-				}
-
+				// keep the title, the freed lines at the bottom are cleared
+				screen_scroll(&screen, 1, SCREEN_ROW_SIZE, 2, ATTR_NORM);
 				y -= 2;
-
-				// clear last lines
-				clear_scr(ATTR_NORM, charout+(y)*SCREEN_COL_SIZE*2, SCREEN_COL_SIZE*2);
 			}
 		}
 		else if(key == 0x0e && x >= x_min+1)	// backspace
 		{
+			line_erase(&line);
 			--x;
-			write_char(' ', ATTR_NORM, charout + y*SCREEN_COL_SIZE*2 + x*2);
+			screen_put(&screen, x, y, ' ', ATTR_NORM);
 		}
 		else if(x < x_max)
 		{
@@ -175,17 +220,18 @@ void run_calc_shell(seL4_SlotPos start_notify, i8 *charout, seL4_SlotPos endpoin
 				}
 			}
 
-			if(ch)
+			if(ch && line_insert(&line, ch))
 			{
-				write_char(ch, ATTR_NORM, charout + y*SCREEN_COL_SIZE*2 + x*2);
+				screen_put(&screen, x, y, ch, ATTR_NORM);
 				++x;
 			}
 		}
 	}
 
+	deinit_line(&ctx, &line);
 	deinit_parser(&ctx);
 
-	printf("End of calculator thread.\n");
+	console_printf("End of calculator thread.\n");
 	while(1) seL4_Yield();
 }
 
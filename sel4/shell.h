@@ -20,7 +20,8 @@
 
 #include "defines.h"
 
-extern void run_calc_shell(seL4_SlotPos start_notify, i8 *charout, seL4_SlotPos endpoint);
+extern void run_calc_shell(seL4_SlotPos start_notify, i8 *charout, seL4_SlotPos endpoint,
+	u8 *jit_mem, u8 *parser_mem, seL4_SlotPos crtc_port);
 
 
 #endif
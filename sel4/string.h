@@ -24,22 +24,52 @@
 #endif
 
 
+#define NUM_STR_LEN 66      // buffer size for integers in any base, with sign and '\0'
+#define REAL_STR_LEN 32     // buffer size for reals, with sign, point, exponent and '\0'
+
+
+/**
+ * string which knows its length, so that appending takes constant time
+ */
+struct StrBuf
+{
+	i8 *str;                    // always '\0'-terminated
+	u64 len, cap;               // the capacity includes the '\0'
+	int truncated;              // an append did not fit
+
+	// optional: get a buffer of at least the given size, the old one is not freed
+	i8* (*grow)(void* user, u64 size);
+	void *user;
+};
+
+
 extern void reverse_str(i8* buf, u64 len);
 
 extern i8 digit_to_char(u8 num, u64 base);
-extern void uint_to_str(u64 num, u64 base, i8* buf);
-extern void int_to_str(i64 num, u64 base, i8* buf);
-extern void real_to_str(f64 num, u64 base, i8* buf, u8 decimals);
+extern u64 uint_to_str(u64 num, u64 base, i8* buf);
+extern u64 int_to_str(i64 num, u64 base, i8* buf);
+extern u64 real_to_str(f64 num, i8* buf);
 
-extern i64 my_atoi(const i8* str, i64 base);
-extern f64 my_atof(const i8* str, i64 base);
+extern u64 my_atoi(const i8* str, i64 base, i64* val);
+extern u64 my_atof(const i8* str, f64* val);
 
 extern void my_strncpy(i8* str_dst, const i8* str_src, u64 max_len);
 extern void my_strncat(i8* str_dst, const i8* str_src, u64 max_len);
 extern void strncat_char(i8* str, i8 c, u64 max_len);
 
+extern void strbuf_init(struct StrBuf* buf, i8* mem, u64 cap);
+extern int strbuf_reserve(struct StrBuf* buf, u64 len);
+extern void strbuf_append_n(struct StrBuf* buf, const i8* str, u64 len);
+extern void strbuf_append(struct StrBuf* buf, const i8* str);
+extern void strbuf_append_char(struct StrBuf* buf, i8 c);
+extern void strbuf_append_uint(struct StrBuf* buf, u64 num, u64 base);
+extern void strbuf_append_int(struct StrBuf* buf, i64 num, u64 base);
+extern void strbuf_append_real(struct StrBuf* buf, f64 num);
+
 extern i8 my_strncmp(const i8* str1, const i8* str2, u64 max_len);
 extern i8 my_strcmp(const i8* str1, const i8* str2);
+extern u64 my_strhash(const i8* str);
+extern u64 my_strnhash(const i8* str, u64 len);
 
 extern u64 my_strlen(const i8* str);
 extern void my_memset(i8* mem, i8 val, u64 size);
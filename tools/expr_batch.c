@@ -0,0 +1,549 @@
+/**
+ * host tool evaluating a file of newline-separated expressions on all cores
+ *
+ * the memory-mapped input is split into chunks at line boundaries, which are
+ * evaluated by a work-stealing thread pool with one parser context per worker;
+ * the results are written in input order, one line per expression
+ *
+ * lines are meant to be independent expressions, an assignment is
+ * only visible to the following lines evaluated by the same worker;
+ * constants given with -D are kept in one environment shared by all workers
+ *
+ * build: make expr_batch, in this directory
+ * usage: expr_batch [-t threads] [-n] [-D name=value]... <input file>
+ *
+ * @author agent
+ * @date 16-oct-2026
+ * @license GPLv3, see 'LICENSE' file
+ *
+ * References:
+ *	- https://en.wikipedia.org/wiki/Work_stealing
+ *	- https://man7.org/linux/man-pages/man2/mmap.2.html
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "expr_parser.h"
+#include "expr_jit.h"
+#include "expr_env.h"
+
+
+#define BATCH_CHUNK_SIZE  (256*1024)    // approximate number of input bytes per chunk
+#define BATCH_MAX_THREADS 256
+#define BATCH_LINE_LEN    256           // initial size of the line buffers
+
+
+// ----------------------------------------------------------------------------
+// data structures
+// ----------------------------------------------------------------------------
+
+/**
+ * consecutive lines of the input and their results
+ */
+struct Chunk
+{
+	const char *begin, *end;
+
+	char *out;              // formatted results
+	u64 out_len, out_cap;
+	int out_failed;         // the results could not be stored
+
+	atomic_int done;
+};
+
+
+/**
+ * worker owning the chunks [head, tail), it takes them from the head
+ * while other workers steal from the tail
+ */
+struct Worker
+{
+	// head in the lower, tail in the upper 32 bits, so both can be updated at once
+	_Alignas(64) _Atomic u64 range;
+
+	struct Batch *batch;
+	pthread_t thread;
+	int idx;
+};
+
+
+struct Batch
+{
+	struct Chunk *chunks;
+	u32 num_chunks;
+
+	struct Worker *workers;
+	int num_workers;
+	int use_jit;
+	struct SharedEnv env;       // constants given on the command line
+
+	// chunks are written in order as soon as their predecessors are
+	pthread_mutex_t flush_mutex;
+	u32 next_flush;
+	int write_failed;
+};
+// ----------------------------------------------------------------------------
+
+
+
+// ----------------------------------------------------------------------------
+// work stealing
+// ----------------------------------------------------------------------------
+
+static u64 make_range(u32 head, u32 tail)
+{
+	return ((u64)tail << 32) | head;
+}
+
+
+/**
+ * take the next chunk of the worker's own range
+ */
+static int pop_chunk(struct Worker* worker, u32* chunk)
+{
+	u64 range = atomic_load(&worker->range);
+	while(1)
+	{
+		u32 head = (u32)range, tail = (u32)(range >> 32);
+		if(head >= tail)
+			return 0;
+
+		if(atomic_compare_exchange_weak(&worker->range, &range, make_range(head + 1, tail)))
+		{
+			*chunk = head;
+			return 1;
+		}
+	}
+}
+
+
+/**
+ * take the last chunk of another worker's range
+ */
+static int steal_chunk(struct Worker* victim, u32* chunk)
+{
+	u64 range = atomic_load(&victim->range);
+	while(1)
+	{
+		u32 head = (u32)range, tail = (u32)(range >> 32);
+		if(head >= tail)
+			return 0;
+
+		if(atomic_compare_exchange_weak(&victim->range, &range, make_range(head, tail - 1)))
+		{
+			*chunk = tail - 1;
+			return 1;
+		}
+	}
+}
+
+
+/**
+ * @return 0 if there is no work left, no new chunks are added while running
+ */
+static int next_chunk(struct Worker* worker, u32* chunk)
+{
+	if(pop_chunk(worker, chunk))
+		return 1;
+
+	const struct Batch *batch = worker->batch;
+	for(int i=1; i<batch->num_workers; ++i)
+	{
+		struct Worker *victim = batch->workers + (worker->idx + i) % batch->num_workers;
+		if(steal_chunk(victim, chunk))
+			return 1;
+	}
+
+	return 0;
+}
+// ----------------------------------------------------------------------------
+
+
+
+// ----------------------------------------------------------------------------
+// evaluation
+// ----------------------------------------------------------------------------
+
+static void append_output(struct Chunk* chunk, const char* str, u64 len)
+{
+	if(chunk->out_len + len > chunk->out_cap)
+	{
+		u64 new_cap = chunk->out_cap ? chunk->out_cap*2 : 4096;
+		while(new_cap < chunk->out_len + len)
+			new_cap *= 2;
+
+		char *new_out = (char*)realloc(chunk->out, new_cap);
+		if(!new_out)
+		{
+			chunk->out_failed = 1;
+			return;
+		}
+
+		chunk->out = new_out;
+		chunk->out_cap = new_cap;
+	}
+
+	my_memcpy(chunk->out + chunk->out_len, (i8*)str, len);
+	chunk->out_len += len;
+}
+
+
+/**
+ * write the finished chunks which are next in order
+ */
+static void flush_chunks(struct Batch* batch)
+{
+	pthread_mutex_lock(&batch->flush_mutex);
+
+	while(batch->next_flush < batch->num_chunks)
+	{
+		struct Chunk *chunk = batch->chunks + batch->next_flush;
+		if(!atomic_load(&chunk->done))
+			break;
+
+		if(chunk->out_failed
+			|| fwrite(chunk->out, 1, chunk->out_len, stdout) != chunk->out_len)
+			batch->write_failed = 1;
+
+		free(chunk->out);
+		chunk->out = 0;
+		++batch->next_flush;
+	}
+
+	pthread_mutex_unlock(&batch->flush_mutex);
+}
+
+
+static void eval_chunk(struct ParserContext* ctx, struct Chunk* chunk,
+	char** line, u64* line_cap)
+{
+	for(const char *pos = chunk->begin; pos < chunk->end; )
+	{
+		const char *line_end = pos;
+		while(line_end < chunk->end && *line_end != '\n')
+			++line_end;
+
+		u64 len = line_end - pos;
+		if(len && pos[len-1] == '\r')
+			--len;
+
+		// the parser needs a terminated string, which is also the key of its cache
+		if(len + 1 > *line_cap)
+		{
+			u64 new_cap = *line_cap * 2;
+			while(new_cap < len + 1)
+				new_cap *= 2;
+
+			char *new_line = (char*)realloc(*line, new_cap);
+			if(!new_line)
+			{
+				chunk->out_failed = 1;
+				return;
+			}
+
+			*line = new_line;
+			*line_cap = new_cap;
+		}
+		my_memcpy(*line, (i8*)pos, len);
+		(*line)[len] = 0;
+
+		char result[128];
+		int result_len = 0;
+
+		if(len)
+		{
+			clear_diagnostics(ctx);
+			t_value val = 0;
+			int status = try_parse(ctx, *line, &val);
+
+			if(status == EXPR_OK)
+			{
+#ifdef USE_INTEGER
+				result_len = (int)int_to_str(val, 10, result);
+#else
+				result_len = (int)real_to_str(val, result);
+#endif
+			}
+			else
+			{
+				const struct Diagnostic *diag = get_diagnostic(ctx, 0);
+				result_len = snprintf(result, sizeof(result), "error: %s%s%s",
+					error_message(status),
+					diag && diag->text[0] ? ": " : "",
+					diag ? diag->text : "");
+			}
+
+			if(result_len >= (int)sizeof(result))
+				result_len = sizeof(result) - 1;
+		}
+
+		result[result_len++] = '\n';
+		append_output(chunk, result, result_len);
+
+		pos = line_end + 1;
+	}
+}
+
+
+static void* run_worker(void* arg)
+{
+	struct Worker *worker = (struct Worker*)arg;
+	struct Batch *batch = worker->batch;
+
+	struct ParserContext ctx;
+	int ok = init_parser(&ctx);
+	attach_env(&ctx, &batch->env);
+	if(batch->use_jit)
+		init_jit(&ctx, 0, 0);
+
+	// the other workers take over the chunks
+	if(!ok)
+		fprintf(stderr, "Error: Cannot initialise worker %d.\n", worker->idx);
+
+	u64 line_cap = BATCH_LINE_LEN;
+	char *line = ok ? (char*)malloc(line_cap) : 0;
+
+	u32 chunk_idx = 0;
+	while(line && next_chunk(worker, &chunk_idx))
+	{
+		struct Chunk *chunk = batch->chunks + chunk_idx;
+		eval_chunk(&ctx, chunk, &line, &line_cap);
+
+		atomic_store(&chunk->done, 1);
+		flush_chunks(batch);
+	}
+
+	free(line);
+	deinit_parser(&ctx);
+	return 0;
+}
+// ----------------------------------------------------------------------------
+
+
+
+// ----------------------------------------------------------------------------
+// setup
+// ----------------------------------------------------------------------------
+
+/**
+ * split the input at line boundaries into chunks of about BATCH_CHUNK_SIZE bytes
+ */
+static struct Chunk* split_chunks(const char* input, u64 size, u32* num_chunks)
+{
+	u64 max_chunks = size / BATCH_CHUNK_SIZE + 1;
+	struct Chunk *chunks = (struct Chunk*)calloc(max_chunks, sizeof(struct Chunk));
+	if(!chunks)
+		return 0;
+
+	u32 num = 0;
+	for(u64 pos = 0; pos < size; )
+	{
+		u64 end = pos + BATCH_CHUNK_SIZE;
+		if(end >= size)
+		{
+			end = size;
+		}
+		else
+		{
+			while(end < size && input[end-1] != '\n')
+				++end;
+		}
+
+		chunks[num].begin = input + pos;
+		chunks[num].end = input + end;
+		atomic_init(&chunks[num].done, 0);
+		++num;
+
+		pos = end;
+	}
+
+	*num_chunks = num;
+	return chunks;
+}
+
+
+/**
+ * add a constant given as name=value to the environment
+ */
+static int define_const(struct ExprEnv* env, char* def)
+{
+	char *eq = def;
+	while(*eq && *eq != '=')
+		++eq;
+	if(!*eq || eq == def)
+		return 0;
+
+	char *end = 0;
+	double val = strtod(eq + 1, &end);
+	if(end == eq + 1 || *end)
+		return 0;
+
+	*eq = 0;
+	int ok = env_set_const(env, def, (t_value)val);
+	*eq = '=';
+	return ok;
+}
+
+
+static void usage(const char* prog)
+{
+	fprintf(stderr, "Usage: %s [-t threads] [-n] [-D name=value]... <input file>\n", prog);
+	fprintf(stderr, "\t-t: number of worker threads, default: number of cores\n");
+	fprintf(stderr, "\t-n: compile the expressions to native code\n");
+	fprintf(stderr, "\t-D: define a constant\n");
+}
+
+
+int main(int argc, char** argv)
+{
+	int num_workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	int use_jit = 0;
+
+	// the workers only read the environment, so it is built before they start
+	struct Batch batch;
+	init_shared_env(&batch.env, &libc_allocator);
+	struct ExprEnv *env = copy_shared_env(&batch.env);
+	if(!env)
+	{
+		fprintf(stderr, "Error: Out of memory.\n");
+		return -1;
+	}
+
+	int opt;
+	while((opt = getopt(argc, argv, "t:nD:")) != -1)
+	{
+		switch(opt)
+		{
+			case 't':
+				num_workers = atoi(optarg);
+				break;
+			case 'n':
+				use_jit = 1;
+				break;
+			case 'D':
+				if(!define_const(env, optarg))
+				{
+					fprintf(stderr, "Error: Invalid definition \"%s\".\n", optarg);
+					return -1;
+				}
+				break;
+			default:
+				usage(argv[0]);
+				return -1;
+		}
+	}
+
+	if(optind != argc - 1)
+	{
+		usage(argv[0]);
+		return -1;
+	}
+	publish_env(&batch.env, env);
+
+	if(num_workers < 1)
+		num_workers = 1;
+	if(num_workers > BATCH_MAX_THREADS)
+		num_workers = BATCH_MAX_THREADS;
+
+	// map the input
+	const char *filename = argv[optind];
+	int fd = open(filename, O_RDONLY);
+	struct stat st;
+	if(fd < 0 || fstat(fd, &st) != 0)
+	{
+		fprintf(stderr, "Error: Cannot open \"%s\".\n", filename);
+		return -1;
+	}
+
+	u64 size = (u64)st.st_size;
+	if(!size)
+	{
+		close(fd);
+		return 0;
+	}
+
+	const char *input = (const char*)mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(input == MAP_FAILED)
+	{
+		fprintf(stderr, "Error: Cannot map \"%s\".\n", filename);
+		return -1;
+	}
+	madvise((void*)input, size, MADV_SEQUENTIAL);
+
+	batch.chunks = split_chunks(input, size, &batch.num_chunks);
+	batch.workers = (struct Worker*)aligned_alloc(64, num_workers * sizeof(struct Worker));
+	batch.num_workers = num_workers;
+	batch.use_jit = use_jit;
+	batch.next_flush = 0;
+	batch.write_failed = 0;
+	pthread_mutex_init(&batch.flush_mutex, 0);
+
+	if(!batch.chunks || !batch.workers)
+	{
+		fprintf(stderr, "Error: Out of memory.\n");
+		return -1;
+	}
+
+	// give each worker a contiguous range of chunks and start the pool
+	for(int i=0; i<num_workers; ++i)
+	{
+		struct Worker *worker = batch.workers + i;
+		u32 head = (u64)batch.num_chunks * i / num_workers;
+		u32 tail = (u64)batch.num_chunks * (i+1) / num_workers;
+
+		atomic_init(&worker->range, make_range(head, tail));
+		worker->batch = &batch;
+		worker->idx = i;
+	}
+
+	for(int i=0; i<num_workers; ++i)
+	{
+		struct Worker *worker = batch.workers + i;
+		if(pthread_create(&worker->thread, 0, &run_worker, worker) != 0)
+		{
+			// the other workers steal the chunks of this one
+			worker->idx = -1;
+		}
+	}
+
+	int started = 0;
+	for(int i=0; i<num_workers; ++i)
+	{
+		if(batch.workers[i].idx >= 0)
+		{
+			pthread_join(batch.workers[i].thread, 0);
+			++started;
+		}
+	}
+
+	// no thread could be started
+	if(!started)
+	{
+		batch.workers[0].idx = 0;
+		run_worker(batch.workers);
+	}
+
+	flush_chunks(&batch);
+	fflush(stdout);
+
+	int ok = !batch.write_failed && batch.next_flush == batch.num_chunks;
+	if(!ok)
+		fprintf(stderr, "Error: Not all results could be written.\n");
+
+	pthread_mutex_destroy(&batch.flush_mutex);
+	deinit_shared_env(&batch.env);
+	free(batch.workers);
+	free(batch.chunks);
+	munmap((void*)input, size);
+
+	return ok ? 0 : -1;
+}
+// ----------------------------------------------------------------------------
@@ -0,0 +1,817 @@
+/**
+ * regression checks for the calculator's expression parser, run on the host
+ *
+ * build and run: make check, in this directory
+ *
+ * @author agent
+ * @date 16-oct-2026
+ * @license GPLv3, see 'LICENSE' file
+ */
+
+#include <stdio.h>
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+#include "expr_parser.h"
+#include "expr_deps.h"
+#include "expr_diag.h"
+#include "expr_jit.h"
+#include "expr_funcs.h"
+#include "expr_env.h"
+
+
+#define SHELL_PARSER_MEM (128*4096)     // PARSER_HEAP_PAGES pages, see sel4/defines.h
+
+
+static int num_checks = 0;
+static int num_failed = 0;
+
+
+static void check(int ok, const char* what)
+{
+	++num_checks;
+	if(ok)
+		return;
+
+	++num_failed;
+	printf("Failed: %s.\n", what);
+}
+
+
+/**
+ * equal values, nan compares unequal to itself
+ */
+static int same_value(t_value val1, t_value val2)
+{
+#ifdef USE_INTEGER
+	return val1 == val2;
+#else
+	return val1 == val2 || (val1 != val1 && val2 != val2);
+#endif
+}
+
+
+/**
+ * xorshift generator, reproducible across c libraries
+ * @see https://en.wikipedia.org/wiki/Xorshift
+ */
+static u64 random_state = 0x9e3779b97f4a7c15ul;
+
+static u64 random_u64(void)
+{
+	random_state ^= random_state << 13;
+	random_state ^= random_state >> 7;
+	random_state ^= random_state << 17;
+	return random_state;
+}
+
+
+/**
+ * random number in [0, num)
+ */
+static u32 random_below(u32 num)
+{
+	return (u32)(random_u64() % num);
+}
+
+
+// ----------------------------------------------------------------------------
+// memory
+// ----------------------------------------------------------------------------
+
+static int define_variables(struct ParserContext* ctx, int num)
+{
+	for(int i=0; i<num; ++i)
+	{
+		char expr[64];
+		snprintf(expr, sizeof(expr), "v%d = %d", i, i);
+
+		t_value val = 0;
+		if(try_parse(ctx, expr, &val) != EXPR_OK || val != i)
+			return 0;
+	}
+
+	return 1;
+}
+
+
+/**
+ * the shell's parser works in fixed memory
+ */
+static void check_fixed_memory(void)
+{
+	void *mem = aligned_alloc(4096, SHELL_PARSER_MEM);
+	struct ParserContext ctx;
+
+	check(init_parser_mem(&ctx, mem, SHELL_PARSER_MEM), "initialising the parser in fixed memory");
+	check(define_variables(&ctx, 4000), "defining 4000 variables in the shell's memory");
+
+	t_value val = 0;
+	check(try_parse(&ctx, "v3999 + v0", &val) == EXPR_OK && val == 3999, "reading the variables");
+	deinit_parser(&ctx);
+
+	// freed blocks are reused
+	check(init_parser_mem(&ctx, mem, SHELL_PARSER_MEM), "reinitialising the parser");
+	int ok = 1;
+	for(int i=0; i<20000 && ok; ++i)
+		ok = try_parse(&ctx, i % 2 ? "f(x) = x*x + 1" : "f(x) = x + 2", &val) == EXPR_OK;
+	check(ok, "redefining a function");
+	deinit_parser(&ctx);
+
+	// failures are reported at initialisation
+	check(!init_parser_mem(&ctx, mem, 256), "initialising the parser in too small memory");
+	check(num_diagnostics(&ctx) == 1 && get_diagnostic(&ctx, 0)->code == EXPR_ERR_MEMORY,
+		"memory error at initialisation");
+	deinit_parser(&ctx);
+
+	free(mem);
+}
+// ----------------------------------------------------------------------------
+
+
+
+// ----------------------------------------------------------------------------
+// dependency graph
+// ----------------------------------------------------------------------------
+
+/**
+ * plain values don't get nodes in the dependency graph
+ */
+static void check_many_variables(void)
+{
+	struct ParserContext ctx;
+	init_parser(&ctx);
+
+	check(define_variables(&ctx, 500), "defining 500 variables");
+	check(!ctx.deps, "no dependency graph for plain values");
+
+	t_value val = 0;
+	check(try_parse(&ctx, "v1 = v3 + 1", &val) == EXPR_OK && val == 4, "formula reading a variable");
+	check(ctx.deps && ctx.deps->num_nodes <= 4, "dependency nodes only up to the formula's variables");
+
+	try_parse(&ctx, "v3 = 10", &val);
+	check(try_parse(&ctx, "v1", &val) == EXPR_OK && val == 11, "recomputing the formula");
+
+	deinit_parser(&ctx);
+}
+
+
+static u32 num_pool_tasks = 0;
+
+
+/**
+ * worker pool running the tasks one after the other, counting them
+ */
+static void run_pool(void* user, t_task task, void* arg, u32 num)
+{
+	(void)user;
+	num_pool_tasks += num;
+	for(u32 i=0; i<num; ++i)
+		(*task)(arg, i);
+}
+
+
+static t_value count_calls(t_value x)
+{
+	static int num_calls = 0;
+	return x + ++num_calls;
+}
+
+
+/**
+ * only formulas which cannot fail or call the embedder's functions run concurrently
+ */
+static void check_parallel_formulas(void)
+{
+	struct ParserContext ctx;
+	init_parser(&ctx);
+
+	struct ExprTaskPool pool = { .run = &run_pool, .user = 0 };
+	ctx.pool = &pool;
+	register_func1(&ctx, "count", &count_calls);
+
+	t_value val = 0;
+	const char* exprs[] = { "a = 1", "x1 = count(a)", "x2 = count(a) + 1", "y1 = a + 1", "y2 = sin(a)*2" };
+	for(unsigned i=0; i<sizeof(exprs)/sizeof(*exprs); ++i)
+		try_parse(&ctx, exprs[i], &val);
+
+	num_pool_tasks = 0;
+	try_parse(&ctx, "a = 2", &val);
+	check(num_pool_tasks == 2, "formulas calling the embedder's functions run one after the other");
+	check(parse(&ctx, "y1") == 3 && parse(&ctx, "x2") > 2, "recomputing formulas with and without the pool");
+
+	deinit_parser(&ctx);
+}
+
+
+static t_value add_one(t_value x)
+{
+	return x + 1;
+}
+
+
+static t_value add_hundred(t_value x)
+{
+	return x + 100;
+}
+
+
+/**
+ * formulas are compiled again when the functions or constants they use are replaced
+ */
+static void check_replaced_definitions(void)
+{
+	struct ParserContext ctx;
+	init_parser(&ctx);
+
+	struct SharedEnv shared;
+	init_shared_env(&shared, &libc_allocator);
+	struct ExprEnv *env = copy_shared_env(&shared);
+	env_set_const(env, "k", 5);
+	publish_env(&shared, env);
+	attach_env(&ctx, &shared);
+
+	t_value val = 0;
+	register_func1(&ctx, "g", &add_one);
+	try_parse(&ctx, "a = 1", &val);
+	try_parse(&ctx, "y = g(a)", &val);
+	try_parse(&ctx, "z = y + a*k", &val);
+
+	register_func1(&ctx, "g", &add_hundred);
+	try_parse(&ctx, "a = 2", &val);
+	check(parse(&ctx, "y") == parse(&ctx, "g(a)") && parse(&ctx, "y") == 102,
+		"formula calling a registered function which has been replaced");
+
+	env = copy_shared_env(&shared);
+	env_set_const(env, "k", 7);
+	publish_env(&shared, env);
+	check(parse(&ctx, "z") == 102 + 2*7, "formula using a shared constant which has been replaced");
+
+	deinit_parser(&ctx);
+	deinit_shared_env(&shared);
+}
+// ----------------------------------------------------------------------------
+
+
+// ----------------------------------------------------------------------------
+// input line
+// ----------------------------------------------------------------------------
+
+/**
+ * type the keys into the line, '\b' erases the last character
+ */
+static void type_line(struct ExprLine* line, const char* keys)
+{
+	clear_line(line);
+
+	for(const char* c=keys; *c; ++c)
+	{
+		if(*c == '\b')
+			line_erase(line);
+		else
+			line_insert(line, *c);
+	}
+}
+
+
+/**
+ * the incrementally lexed line evaluates like its whole text
+ */
+static int line_matches_text(struct ParserContext* ctx, struct ExprLine* line)
+{
+	t_value line_val = 0, text_val = 0;
+	int line_err = try_parse_line(ctx, line, &line_val);
+	int text_err = try_parse(ctx, line->text, &text_val);
+
+	return line_err == text_err && (line_err != EXPR_OK || same_value(line_val, text_val));
+}
+
+
+/**
+ * erasing the end of an incomplete exponent
+ */
+static void check_line_erase(void)
+{
+	struct ParserContext ctx;
+	init_parser(&ctx);
+
+	struct ExprLine line;
+	check(init_line(&ctx, &line, 32), "allocating the input line");
+
+	const char* keys[][2] =
+	{
+		{ "7e-,\b9", "typing 7e-, backspace, 9" },
+		{ "7e-x\b9", "typing 7e-x, backspace, 9" },
+		{ "78e-e\b7", "typing 78e-e, backspace, 7" },
+		{ "1e+\b\b5", "typing 1e+, backspace, backspace, 5" },
+		{ "2 e-\b\b-3", "typing 2 e-, backspace, backspace, -3" },
+	};
+	for(unsigned i=0; i<sizeof(keys)/sizeof(*keys); ++i)
+	{
+		type_line(&line, keys[i][0]);
+		check(line_matches_text(&ctx, &line), keys[i][1]);
+	}
+
+	// random typing and erasing
+	const char chars[] = "17e.-,x\b\b";
+	srand(1234);
+	int ok = 1;
+	for(int run=0; run<100000 && ok; ++run)
+	{
+		char typed[16];
+		int num = rand() % (sizeof(typed) - 1);
+		for(int i=0; i<num; ++i)
+			typed[i] = chars[rand() % (sizeof(chars) - 1)];
+		typed[num] = 0;
+
+		type_line(&line, typed);
+		ok = line_matches_text(&ctx, &line);
+		if(!ok)
+			printf("Mismatch for the line \"%s\".\n", line.text);
+	}
+	check(ok, "random typing and erasing");
+
+	deinit_line(&ctx, &line);
+	deinit_parser(&ctx);
+}
+// ----------------------------------------------------------------------------
+
+
+// ----------------------------------------------------------------------------
+// native code
+// ----------------------------------------------------------------------------
+
+/**
+ * the same input gives the same results and variables in both contexts
+ */
+static int same_results(struct ParserContext* ctx1, struct ParserContext* ctx2, const char* expr)
+{
+	t_value val1 = 0, val2 = 0;
+	int err1 = try_parse(ctx1, expr, &val1);
+	int err2 = try_parse(ctx2, expr, &val2);
+
+	return err1 == err2 && same_value(val1, val2);
+}
+
+
+/**
+ * failing variable accesses stop the native code before it stores anything
+ */
+static void check_jit_errors(void)
+{
+	struct ParserContext interp, jit;
+	init_parser(&interp);
+	init_parser(&jit);
+	init_jit(&jit, 0, 0);
+
+	const char* exprs[] =
+	{
+		"u = v + 1", "p = p + 1", "s = r",
+		"w = 2", "w = w*v", "a = 3", "b = 2*a", "b = a + z", "a = 5",
+		"u", "p", "s", "w", "b",
+	};
+
+	int ok = 1;
+	for(unsigned i=0; i<sizeof(exprs)/sizeof(*exprs); ++i)
+	{
+		int same = same_results(&interp, &jit, exprs[i]);
+		if(!same)
+			printf("Native code and interpreter differ for \"%s\".\n", exprs[i]);
+		ok = ok && same;
+	}
+	check(ok, "failing assignments in native code");
+
+	deinit_parser(&jit);
+	deinit_parser(&interp);
+}
+
+
+/**
+ * write a random expression of the given depth
+ */
+static void random_expr(struct StrBuf* buf, int depth)
+{
+	static const char* leaves[] = { "a", "b", "c", "u", "0", "1", "2", "0.5", "3e2", "pi" };
+	static const char* binary[] = { " + ", " - ", "*", "/", "^", "%" };
+	static const char* unary[] = { "-", "sin", "sqrt", "log", "atan" };
+
+	u32 kind = depth > 0 ? random_below(4) : 0;
+	if(kind == 0)
+	{
+		strbuf_append(buf, leaves[random_below(sizeof(leaves)/sizeof(*leaves))]);
+	}
+	else if(kind == 1)
+	{
+		strbuf_append(buf, unary[random_below(sizeof(unary)/sizeof(*unary))]);
+		strbuf_append_char(buf, '(');
+		random_expr(buf, depth - 1);
+		strbuf_append_char(buf, ')');
+	}
+	else
+	{
+		strbuf_append_char(buf, '(');
+		random_expr(buf, depth - 1);
+		strbuf_append(buf, binary[random_below(sizeof(binary)/sizeof(*binary))]);
+		random_expr(buf, depth - 1);
+		strbuf_append_char(buf, ')');
+	}
+}
+
+
+/**
+ * native code computes the same as the interpreter for random expressions and assignments
+ */
+static void check_jit_random(void)
+{
+#ifdef USE_INTEGER
+	// there is no native code for integers, whose division may trap on random operands
+	return;
+#endif
+
+	struct ParserContext interp, jit;
+	init_parser(&interp);
+	init_parser(&jit);
+	init_jit(&jit, 0, 0);
+
+	const char* vars[] = { "a = 1.5", "b = -2", "c = 1e-3" };
+	for(unsigned i=0; i<sizeof(vars)/sizeof(*vars); ++i)
+		same_results(&interp, &jit, vars[i]);
+
+	int ok = 1;
+	for(int run=0; run<20000 && ok; ++run)
+	{
+		char mem[1024];
+		struct StrBuf expr;
+		strbuf_init(&expr, mem, sizeof(mem));
+
+		// some assignments, also to the variable which is not defined yet
+		if(random_below(4) == 0)
+			strbuf_append(&expr, random_below(2) ? "c = " : "u = ");
+		random_expr(&expr, 1 + random_below(5));
+
+		ok = same_results(&interp, &jit, expr.str);
+		if(!ok)
+			printf("Native code and interpreter differ for \"%s\".\n", expr.str);
+	}
+	check(ok, "random expressions in native code");
+
+	deinit_parser(&jit);
+	deinit_parser(&interp);
+}
+// ----------------------------------------------------------------------------
+
+
+// ----------------------------------------------------------------------------
+// optimisation
+// ----------------------------------------------------------------------------
+
+/**
+ * identities only drop operands which have no effects
+ */
+static void check_dropped_operands(void)
+{
+	for(int native=0; native<2; ++native)
+	{
+		struct ParserContext ctx;
+		init_parser(&ctx);
+		if(native)
+			init_jit(&ctx, 0, 0);
+
+		t_value val = 0;
+		check(try_parse(&ctx, "z = (x = 2)^0", &val) == EXPR_OK && val == 1, "power of an assignment");
+		check(try_parse(&ctx, "x", &val) == EXPR_OK && val == 2, "assignment in a dropped operand");
+		check(try_parse(&ctx, "q^0", &val) == EXPR_ERR_UNKNOWN_IDENT, "unknown variable in a dropped operand");
+
+		try_parse(&ctx, "x = 3", &val);
+		check(try_parse(&ctx, "(x = x + 1)^2", &val) == EXPR_OK && val == 16 && parse(&ctx, "x") == 4,
+			"squared assignment evaluated once");
+
+		deinit_parser(&ctx);
+	}
+}
+// ----------------------------------------------------------------------------
+
+
+// ----------------------------------------------------------------------------
+// string primitives
+// ----------------------------------------------------------------------------
+
+#define CHECK_PAGE 4096
+
+// the libc functions as reference, <string.h> is the kernel's one here
+
+
+/**
+ * comparison of the original byte-wise loop, with signed characters
+ */
+static int ref_strncmp(const i8* str1, const i8* str2, u64 max_len)
+{
+	for(u64 i=0; i<max_len; ++i)
+	{
+		if(str1[i] != str2[i])
+			return str1[i] < str2[i] ? -1 : 1;
+		if(!str1[i])
+			break;
+	}
+
+	return 0;
+}
+
+
+static void random_bytes(i8* mem, u64 len, int non_zero)
+{
+	for(u64 i=0; i<len; ++i)
+	{
+		mem[i] = (i8)random_u64();
+		if(non_zero && !mem[i])
+			mem[i] = 'x';
+	}
+}
+
+
+/**
+ * random placement of len bytes in the page, often ending right before the next page
+ */
+static u64 random_offset(u64 len)
+{
+	if(random_below(2))
+		return CHECK_PAGE - len;
+	return random_below(CHECK_PAGE - len + 1);
+}
+
+
+/**
+ * the vectorised and word-wise functions give the results of byte-wise loops,
+ * also for strings ending right before an inaccessible page
+ */
+static void check_string_primitives(void)
+{
+	// the page after the strings is inaccessible
+	i8 *pages = (i8*)mmap(0, 2*CHECK_PAGE, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(pages == MAP_FAILED || mprotect(pages + CHECK_PAGE, CHECK_PAGE, PROT_NONE) != 0)
+	{
+		check(0, "mapping the pages for the string checks");
+		return;
+	}
+
+	static i8 ref[CHECK_PAGE], other[CHECK_PAGE];
+	int ok_len = 1, ok_cmp = 1, ok_cpy = 1, ok_set = 1;
+
+	for(int run=0; run<200000; ++run)
+	{
+		u64 len = random_below(run % 8 ? 80 : 1200);
+
+		// length of a string
+		i8 *str = pages + random_offset(len + 1);
+		random_bytes(str, len, 1);
+		str[len] = 0;
+		ok_len = ok_len && my_strlen(str) == len;
+
+		// comparison with a copy, which may differ in one character
+		i8 *str2 = pages + random_offset(len + 1);
+		__builtin_memmove(str2, str, len + 1);
+		if(len && random_below(2))
+			str2[random_below(len + 1)] = (i8)random_u64();
+		u64 max_len = random_below(3) ? len + 1 : random_below(len + 2);
+		my_memcpy(other, str2, len + 1);
+		ok_cmp = ok_cmp && my_strncmp(str, other, max_len) == ref_strncmp(str, other, max_len)
+			&& my_strncmp(str, str2, max_len) == ref_strncmp(str, str2, max_len);
+
+		// copy, also forwards between overlapping regions
+		i8 *src = pages + random_offset(len);
+		i8 *dst = random_below(4) ? pages + random_offset(len) : src - random_below(src - pages + 1);
+		if(dst > src && dst < src + len)
+		{
+			i8 *tmp = dst;
+			dst = src;
+			src = tmp;
+		}
+		random_bytes(pages, CHECK_PAGE, 0);
+		__builtin_memcpy(ref, pages, CHECK_PAGE);
+		__builtin_memmove(ref + (dst - pages), ref + (src - pages), len);
+		my_memcpy(dst, src, len);
+		ok_cpy = ok_cpy && __builtin_memcmp(ref, pages, CHECK_PAGE) == 0;
+
+		// setting, the bytes around are kept
+		i8 val = (i8)random_u64();
+		dst = pages + random_offset(len);
+		__builtin_memcpy(ref, pages, CHECK_PAGE);
+		__builtin_memset(ref + (dst - pages), val, len);
+		my_memset(dst, val, len);
+		ok_set = ok_set && __builtin_memcmp(ref, pages, CHECK_PAGE) == 0;
+	}
+
+	check(ok_len, "string lengths");
+	check(ok_cmp, "string comparisons");
+	check(ok_cpy, "memory copies");
+	check(ok_set, "setting memory");
+
+	munmap(pages, 2*CHECK_PAGE);
+}
+// ----------------------------------------------------------------------------
+
+
+// ----------------------------------------------------------------------------
+// number conversion
+// ----------------------------------------------------------------------------
+
+static f64 bits_to_real(u64 bits)
+{
+	union { u64 u; f64 f; } val = { .u = bits };
+	return val.f;
+}
+
+
+static u64 real_to_bits(f64 num)
+{
+	union { f64 f; u64 u; } val = { .f = num };
+	return val.u;
+}
+
+
+/**
+ * the string of a real reads back as the same bits
+ */
+static int real_string_reads_back(f64 num)
+{
+	i8 buf[REAL_STR_LEN + 1];
+	buf[REAL_STR_LEN] = 'x';
+	u64 len = real_to_str(num, buf);
+
+	char *end = 0;
+	f64 val = strtod(buf, &end);
+	return buf[REAL_STR_LEN] == 'x' && len < REAL_STR_LEN && end == buf + len
+		&& real_to_bits(val) == real_to_bits(num);
+}
+
+
+/**
+ * the shortest decimal representation of reals reads back exactly
+ */
+static void check_real_strings(void)
+{
+	static const struct { f64 num; const char *str; } fixed[] =
+	{
+		{ 0., "0" }, { -0., "-0" }, { -1.5, "-1.5" }, { 0.1, "0.1" }, { 0.3, "0.3" },
+		{ 1e-4, "0.0001" }, { 9.9e-5, "9.9e-05" }, { 1e16, "10000000000000000" },
+		{ 1e17, "1e+17" }, { 5e-324, "5e-324" },
+		{ 1.7976931348623157e308, "1.7976931348623157e+308" },
+		{ 1./0., "inf" }, { -1./0., "-inf" }, { 0./0., "nan" },
+	};
+
+	int ok_fixed = 1;
+	for(u64 i=0; i<sizeof(fixed)/sizeof(*fixed); ++i)
+	{
+		i8 buf[REAL_STR_LEN];
+		u64 len = real_to_str(fixed[i].num, buf);
+		ok_fixed = ok_fixed && len == my_strlen(fixed[i].str)
+			&& my_strcmp(buf, fixed[i].str) == 0;
+	}
+	check(ok_fixed, "strings of special reals");
+
+	int ok_random = 1;
+	for(int run=0; run<400000 && ok_random; ++run)
+	{
+		f64 num;
+		if(run % 2)
+		{
+			// any finite number, including denormals
+			do
+				num = bits_to_real(random_u64());
+			while(num != num || num - num != 0.);
+		}
+		else
+		{
+			// short decimals, whose shortest digits are easy to get wrong
+			f64 scale = 1.;
+			for(u32 i=random_below(20); i>0; --i)
+				scale *= 10.;
+			num = (f64)(random_u64() >> random_below(64)) / scale;
+		}
+
+		ok_random = real_string_reads_back(num);
+	}
+	check(ok_random, "strings of random reals read back");
+}
+
+
+static void random_digits(struct StrBuf* buf, u32 num)
+{
+	for(u32 i=0; i<num; ++i)
+		strbuf_append_char(buf, (i8)('0' + random_below(10)));
+}
+
+
+/**
+ * random unsigned decimal, sometimes with more digits than fit in the mantissa
+ */
+static void random_decimal(struct StrBuf* buf)
+{
+	u32 kind = random_below(16);
+	u32 max_digits = kind == 0 ? 800 : 26;
+
+	if(random_below(4))
+		random_digits(buf, random_below(max_digits));
+	if(random_below(2))
+	{
+		strbuf_append_char(buf, '.');
+		random_digits(buf, random_below(max_digits));
+	}
+
+	// exponent, possibly without digits
+	if(random_below(2))
+	{
+		strbuf_append_char(buf, random_below(2) ? 'e' : 'E');
+		u32 sign = random_below(3);
+		if(sign)
+			strbuf_append_char(buf, sign == 1 ? '+' : '-');
+		if(random_below(8))
+			strbuf_append_uint(buf, random_below(351), 10);
+	}
+
+	if(kind == 1)
+		strbuf_append_char(buf, 'x');
+}
+
+
+/**
+ * random finite positive real in scientific notation, either rounded to a random
+ * number of digits or exactly halfway to the next real
+ */
+static void random_real_decimal(struct StrBuf* buf)
+{
+	f64 num;
+	do
+		num = bits_to_real(random_u64() >> 1);
+	while(num != num || num - num != 0.);
+
+	char str[1024];
+	f64 next = nextafter(num, 1./0.);
+	if(LDBL_MANT_DIG > DBL_MANT_DIG && next - next == 0. && random_below(2))
+	{
+		// 800 digits hold the exact value
+		long double half = ((long double)num + (long double)next) / 2.L;
+		snprintf(str, sizeof(str), "%.800Le", half);
+	}
+	else
+	{
+		snprintf(str, sizeof(str), "%.*e", (int)random_below(30), num);
+	}
+
+	strbuf_append(buf, str);
+}
+
+
+/**
+ * the conversion of decimals gives the correctly rounded real, like strtod
+ */
+static void check_atof(void)
+{
+	i8 mem[2048];
+	struct StrBuf buf;
+
+	int ok = 1;
+	for(int run=0; run<200000 && ok; ++run)
+	{
+		strbuf_init(&buf, mem, sizeof(mem));
+		if(run % 2)
+			random_decimal(&buf);
+		else
+			random_real_decimal(&buf);
+
+		f64 val = -1.;
+		u64 len = my_atof(buf.str, &val);
+
+		char *end = 0;
+		f64 ref = strtod(buf.str, &end);
+		ok = !buf.truncated && len == (u64)(end - buf.str)
+			&& real_to_bits(val) == real_to_bits(ref);
+		if(!ok)
+			printf("Wrong conversion of \"%s\".\n", buf.str);
+	}
+
+	check(ok, "conversion of random decimals");
+}
+// ----------------------------------------------------------------------------
+
+
+int main()
+{
+	check_fixed_memory();
+	check_many_variables();
+	check_parallel_formulas();
+	check_replaced_definitions();
+	check_line_erase();
+	check_jit_errors();
+	check_jit_random();
+	check_dropped_operands();
+	check_string_primitives();
+	check_real_strings();
+	check_atof();
+
+	printf("%d of %d checks passed.\n", num_checks - num_failed, num_checks);
+	return num_failed ? -1 : 0;
+}